@@ -2,12 +2,20 @@
 #include "li/env.hpp"
 #include "li/parse.hpp"
 #include "li/builtins.hpp"
+#include "li/heap.hpp"
+#include "li/image.hpp"
+#include "li/optimize.hpp"
+#include "li/output.hpp"
+#include "li/profile.hpp"
+#include "li/stats.hpp"
+#include "li/vm.hpp"
 
 #include <unistd.h>
-#include <iostream>
+#include <chrono>
 #include <fstream>
-#include <sstream>
+#include <iostream>
 #include <format>
+#include <optional>
 
 // #define DEBUG
 
@@ -16,71 +24,195 @@ const char * prompt  = "\t";
 const char * version = "V0.03a"; 
 
 void print_usage()
-    { std::cout << "USAGE: ./lisp [filename]" << std::endl; }
+    { lisp::interpreter::output() << "USAGE: ./lisp [--engine=ast|vm] [--heap-size=BYTES[K|M|G]] [--gc-stats] [--stats] [--profile] [--profile-samples=FILE] [--cache-dir=DIR [--compile]] [--unbuffered] [-O0|-O1] [filename]\n"; }
 void print_version()
-    { std::cout << "(lisp repl) " << version << std::endl; }
+    { lisp::interpreter::output() << "(lisp repl) " << version << '\n'; }
+
+// Parse a byte count with an optional K, M or G suffix
+std::optional<std::size_t> parse_size(const std::string & text) {
+    std::size_t pos = 0, value = 0;
+    try { value = std::stoull(text, &pos); }
+    catch (...) { return std::nullopt; }
+    std::string suffix = text.substr(pos);
+    if      (suffix == "")  { return value; }
+    else if (suffix == "K") { return value << 10; }
+    else if (suffix == "M") { return value << 20; }
+    else if (suffix == "G") { return value << 30; }
+    return std::nullopt;
+}
+
+void print_runtime_stats() {
+    for (auto const & [name, value] : lisp::interpreter::runtime_stats_table()) {
+        std::cerr << std::format("stats: {:<20} {:>12}", name, value) << std::endl;
+    }
+}
+
+// Time `body` into `total` (in microseconds), even if it throws.
+template <typename F>
+auto timed(double & total, F && body) {
+    struct Timer {
+        double & total;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ~Timer() { total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(); }
+    } timer { total };
+    return body();
+}
+
+void print_gc_stats() {
+    auto const & stats = lisp::interpreter::heap().stats();
+    std::cerr << std::format("gc: {} collections, {:.3f} ms total pause, {:.3f} ms max pause, "
+                             "{} bytes allocated, {} bytes freed, {} bytes live",
+                             stats.collections, stats.total_pause_ms, stats.max_pause_ms,
+                             stats.allocated, stats.freed, stats.live) << std::endl;
+}
 
 // Print error and exit the program (unrecoverable)
 void panic(std::string const & error_string) {
-    std::cout << "error: " << error_string << std::endl;
+    lisp::interpreter::output() << "error: " << error_string << '\n';
     exit(EXIT_FAILURE);
 }
 
 int main(int argc, char **argv) {
     // Check invocation
-    if (argc > 2) { print_usage(); exit(EXIT_FAILURE); }
+    const char * filename = nullptr;
+    bool use_vm = false; // Tree-walking evaluator by default
+    bool gc_stats = false;
+    bool stats = false;
+    bool profile = false;
+    std::optional<std::string> samples_path; // Folded stacks of sampled calls
+    std::optional<std::string> cache_dir;
+    bool compile = false; // Only save the program image, do not run
+    bool optimize = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if      (arg == "--engine=ast") { use_vm = false; }
+        else if (arg == "--engine=vm")  { use_vm = true;  }
+        else if (arg == "--gc-stats")   { gc_stats = true; }
+        else if (arg == "--stats")      { stats = lisp::interpreter::RuntimeStats::enabled = true; }
+        else if (arg == "--profile")    { profile = true; }
+        else if (arg == "--compile")    { compile = true; }
+        else if (arg == "--unbuffered") { lisp::interpreter::output() << std::unitbuf; }
+        else if (arg == "-O0")          { optimize = false; }
+        else if (arg == "-O1")          { optimize = true; }
+        else if (arg.starts_with("--cache-dir=")) {
+            cache_dir = arg.substr(std::string("--cache-dir=").size());
+            if (cache_dir->empty()) { print_usage(); exit(EXIT_FAILURE); }
+        }
+        else if (arg.starts_with("--profile-samples=")) {
+            samples_path = arg.substr(std::string("--profile-samples=").size());
+            if (samples_path->empty()) { print_usage(); exit(EXIT_FAILURE); }
+        }
+        else if (arg.starts_with("--heap-size=")) {
+            auto size = parse_size(arg.substr(std::string("--heap-size=").size()));
+            if (!size) { print_usage(); exit(EXIT_FAILURE); }
+            lisp::interpreter::heap().set_limit(*size);
+        }
+        else if (arg.starts_with("-") || filename) { print_usage(); exit(EXIT_FAILURE); }
+        else { filename = argv[i]; }
+    }
+    if (compile && (!cache_dir || !filename)) { print_usage(); exit(EXIT_FAILURE); }
+
+    // Profiling
+    std::ofstream samples;
+    if (profile) { lisp::interpreter::profiler().trace(); }
+    if (samples_path) {
+        // Opened first, so a bad path fails before the program runs.
+        samples.open(*samples_path);
+        if (!samples) { panic(std::format("could not open file: {}", *samples_path)); }
+        if (!lisp::interpreter::profiler().sample(std::chrono::milliseconds(1))) {
+            panic("could not start the sampling profiler");
+        }
+    }
 
     // Construct an environment
-    std::unordered_map<std::string, lisp::interpreter::ASTNode::node_ptr> top_level;
+    std::unordered_map<std::string, lisp::interpreter::Value> top_level;
+    lisp::interpreter::heap().add_root(&top_level);
     lisp::interpreter::Builtins builtins; 
-    lisp::interpreter::Env env(&top_level, &builtins.functions);
+    lisp::interpreter::Env env(&top_level, &builtins.procedures);
+
+    // Execution engine
+    lisp::interpreter::VM vm(env);
+    auto run = [&](lisp::interpreter::SeqNode & program) {
+        // Nothing is held across top-level forms, so it is safe to collect.
+        lisp::interpreter::heap().safepoint();
+        return timed(lisp::interpreter::runtime_stats().eval_us, [&]() {
+            return use_vm ? vm.run(program) : program.eval(env);
+        });
+    };
 
     using status = typename lisp::interpreter::Parser::status;
 
-    if ((argc == 2) || (argc == 1 && !isatty(fileno(stdin)))) {
+    if (filename || !isatty(fileno(stdin))) {
         // Read from file or file-like object
-        std::stringstream ss;
-        ss << "(begin ";
-        try {
-            if (argc == 2) {
-                std::ifstream file(argv[1]);
-                if (!file.is_open()) {
-                    panic(std::format("could not open file: {}", argv[1]));
-                }
-                ss << file.rdbuf();
-            } else {
-                ss << std::cin.rdbuf();
-            }
-        } catch (std::exception const & e) {
-            panic(std::format("reading from file: {}",  e.what()));
-        } catch (...) {
-            panic("failed to create an input stream");
+        lisp::interpreter::Source src(std::cin);
+        if (filename && !src.open(filename)) {
+            panic(std::format("could not open file: {}", filename));
+        }
+
+        // Images are keyed by the whole source, so only a mapped
+        // file can be cached.
+        lisp::interpreter::ImageKey key {};
+        std::string image_path;
+        if (cache_dir && src.mapped()) {
+            key = lisp::interpreter::image_key(src.text(), optimize);
+            image_path = lisp::interpreter::image_path(*cache_dir, key);
+        } else if (compile) {
+            panic(std::format("cannot compile: {}", filename));
         }
-        ss << ")";
 
         try {
-            // Parse the data
-            lisp::interpreter::Parser parse(false); // No multiline
-            lisp::interpreter::SeqNode program;
-            parse.parse(ss, program);
-            // Run
-            lisp::interpreter::ASTNode::node_ptr value = program.eval(env);
-            if (!value->is_null()) { std::cout << *value << std::endl; }
+            // Parse and run one top-level form at a time, as if
+            // they were all in a `begin`: stop at the first error,
+            // and print the value of the last one. With a cache,
+            // the forms come from the image of the source if it
+            // has one; if not, they are saved as its image once
+            // all of them have run.
+            lisp::interpreter::Parser parse(false, &builtins.procedures, optimize); // No multiline
+            std::vector<lisp::interpreter::node_ptr> image;
+            double & parse_us = lisp::interpreter::runtime_stats().parse_us;
+            bool cached = !image_path.empty() && !compile && timed(parse_us, [&]() {
+                if (!lisp::interpreter::load_image(image_path, key, &builtins.procedures, image)) { return false; }
+                if (optimize) {
+                    lisp::interpreter::Optimizer optimizer;
+                    for (auto & node : image) { node = optimizer.optimize(node); }
+                }
+                return true;
+            });
+            lisp::interpreter::Value value;
+            for (std::size_t next = 0;;) {
+                lisp::interpreter::SeqNode form;
+                if (cached) {
+                    if (next == image.size()) { break; }
+                    form.sequence_.push_back(image[next++]);
+                } else {
+                    if (timed(parse_us, [&]() { return parse.read(src, form); }) != status::success) { break; }
+                    if (form.sequence_.empty()) {
+                        if (!image_path.empty() && !lisp::interpreter::save_image(image_path, key, image) && compile) {
+                            panic(std::format("could not write image: {}", image_path));
+                        }
+                        break;
+                    }
+                    if (!image_path.empty()) { image.push_back(form.sequence_.front()); }
+                }
+                if (!compile) { value = run(form); }
+            }
+            if (!value.is_null()) { lisp::interpreter::output() << value << '\n'; }
         }
         catch (std::string const & e)
-            { std::cout << "error: " << e << std::endl; }
+            { lisp::interpreter::output() << "error: " << e << '\n'; }
         catch (std::exception const & e)
-            { std::cout << "error: " << e.what() << std::endl; }
+            { lisp::interpreter::output() << "error: " << e.what() << '\n'; }
         catch (char const * e)
-            { std::cout << "error: " << e << std::endl; }
+            { lisp::interpreter::output() << "error: " << e << '\n'; }
         catch (...)
-            { std::cout << "error: " << "runtime: error" << std::endl; }
+            { lisp::interpreter::output() << "error: " << "runtime: error" << '\n'; }
     } else {
-        lisp::interpreter::Parser parse(true); // Allow multiline
+        lisp::interpreter::Parser parse(true, &builtins.procedures, optimize); // Allow multiline
+        // Show everything printed so far before waiting for input.
+        std::cin.tie(&lisp::interpreter::output());
         // Start REPL
         print_version();
         std::string line;
-        std::stringstream ss;
         bool alive = true;
         while (alive) {
             try {
@@ -90,42 +222,53 @@ int main(int argc, char **argv) {
 
                 // Read until a valid s-expression can be assembled, or
                 // we know that one never will be.
-                std::cout << prompt;
+                lisp::interpreter::output() << prompt;
                 while (result == status::incomplete) {
                     
                     std::getline(std::cin, line); // Get a line
 
 #ifdef DEBUG
-                    std::cout << "got line: " << line << std::endl;
+                    lisp::interpreter::output() << "got line: " << line << '\n';
 #endif
 
                     // Escape if EOF reached.
                     if (std::cin.eof() || std::cin.fail())
-                        { std::cout << std::endl; alive = false; break; }
+                        { lisp::interpreter::output() << '\n'; alive = false; break; }
 
-                    // Load the stream
-                    ss.clear(); ss << line;
                     // Parse
-                    result = parse.parse(ss, program); 
+                    result = timed(lisp::interpreter::runtime_stats().parse_us, [&]() {
+                        return parse.parse(line, program);
+                    });
                 }
                 
 #ifdef DEBUG
-                std::cout << program << std::endl;
+                lisp::interpreter::output() << program << '\n';
 #endif
                 // Run
-                lisp::interpreter::ASTNode::node_ptr value = program.eval(env);
-                if (!value->to_string().empty()) { std::cout << *value << std::endl; }
+                lisp::interpreter::Value value = run(program);
+                if (!value.to_string().empty()) { lisp::interpreter::output() << value << '\n'; }
             }
             catch (std::string const & e)
-                { std::cout << "error: " << e << std::endl; }
+                { lisp::interpreter::output() << "error: " << e << '\n'; }
             catch (std::exception const & e)
-                { std::cout << "error: " << e.what() << std::endl; }
+                { lisp::interpreter::output() << "error: " << e.what() << '\n'; }
             catch (char const * e)
-                { std::cout << "error: " << e << std::endl; }
+                { lisp::interpreter::output() << "error: " << e << '\n'; }
             catch (...)
-                { std::cout << "error: " << "runtime: error" << std::endl; }
+                { lisp::interpreter::output() << "error: " << "runtime: error" << '\n'; }
         }
     }
 
+    // Reports go to stderr, after what the program printed.
+    lisp::interpreter::output().flush();
+    if (gc_stats) { print_gc_stats(); }
+    if (stats) { print_runtime_stats(); }
+    if (profile) { lisp::interpreter::profiler().report(std::cerr); }
+    if (samples_path) {
+        lisp::interpreter::profiler().write_samples(samples);
+        if (auto dropped = lisp::interpreter::profiler().dropped()) {
+            std::cerr << std::format("profile: {} samples dropped", dropped) << std::endl;
+        }
+    }
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,256 @@
+#include "li/ast.hpp"
+#include "li/env.hpp"
+#include "li/parse.hpp"
+#include "li/builtins.hpp"
+#include "li/heap.hpp"
+#include "li/vm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Times the parsing and evaluation of each program of the benchmark
+// corpus separately, over several runs, and prints one tab-separated
+// row per benchmark and phase:
+//
+//   benchmark  phase  runs  median_ms  min_ms  max_ms
+//
+// where the phase is `parse`, `ast` (tree-walking evaluation), `compile`
+// (to bytecode) or `vm` (evaluation of the compiled program on the VM),
+// so each engine is timed on running alone. Each phase is run once before
+// it is timed, so that every timed run starts from a used heap. Given a
+// baseline (a previous output), each median is compared against it, and
+// the exit status is non-zero if any is slower by more than the threshold.
+
+namespace li = lisp::interpreter;
+
+using forms = std::vector<li::node_ptr>;
+using scripts = std::vector<std::shared_ptr<const li::Function>>;
+
+// Medians shorter than this are too noisy to flag as regressions.
+constexpr double noise_ms = 10.0;
+
+void print_usage()
+{
+    std::cerr << "USAGE: ./lisp_bench [--runs=N] [--engine=ast|vm|all] [--baseline=FILE] "
+                 "[--threshold=PERCENT] files..." << std::endl;
+}
+
+struct Result {
+    std::string benchmark;
+    std::string phase;
+    std::vector<double> times; // ms, sorted
+
+    double median() const { return times[times.size() / 2]; }
+};
+
+template <typename F>
+double time_ms(F && body)
+{
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A large source of distinct definitions, to time parsing on its own
+std::string large_source(std::size_t bytes)
+{
+    std::string text;
+    text.reserve(bytes + 256);
+    for (std::size_t i = 0; text.size() < bytes; ++i) {
+        text += std::format(
+            "(define (f{0} x y) ; definition {0}\n"
+            "    (let* ((a (+ x {0})) (b (* a y)) (c (list a b #t #f)))\n"
+            "        (cond ((< a b) (cons a (car c)))\n"
+            "              ((= a b) (if (> a 0) (lambda (z) (- z a b)) ()))\n"
+            "              (#t (and (or #f a) (append c (list -{0} +{0})))))))\n", i);
+    }
+    return text;
+}
+
+forms parse(std::string_view text, const li::Builtins & builtins)
+{
+    li::Source src(text);
+    li::Parser parser(false, &builtins.procedures);
+    forms result;
+    for (;;) {
+        li::SeqNode form;
+        if (parser.read(src, form) != li::Parser::status::success) { throw std::string("parse failed"); }
+        if (form.sequence_.empty()) { break; }
+        result.push_back(form.sequence_.front());
+    }
+    return result;
+}
+
+scripts compile(const forms & program)
+{
+    scripts result;
+    for (auto const & node : program) {
+        li::SeqNode form;
+        form.sequence_.push_back(node);
+        result.push_back(li::Compiler().compile(form));
+    }
+    return result;
+}
+
+// Evaluate `program` in a fresh top-level environment, on the VM if it
+// has been `compiled`.
+double evaluate(const forms & program, const scripts * compiled, const li::Builtins & builtins)
+{
+    std::unordered_map<std::string, li::Value> top_level;
+    li::heap().add_root(&top_level);
+    li::Env env(&top_level, &builtins.procedures);
+    li::VM vm(env);
+
+    // Start every run from a collected heap.
+    li::heap().collect();
+    double ms = time_ms([&]() {
+        for (std::size_t i = 0; i < program.size(); ++i) {
+            li::heap().safepoint();
+            if (compiled) {
+                vm.run(*(*compiled)[i]);
+            } else {
+                li::SeqNode form;
+                form.sequence_.push_back(program[i]);
+                form.eval(env);
+            }
+        }
+    });
+
+    li::heap().remove_root(&top_level);
+    return ms;
+}
+
+// Medians of a previous run, by benchmark and phase
+std::map<std::pair<std::string, std::string>, double> read_baseline(const std::string & path)
+{
+    std::ifstream file(path);
+    if (!file) { throw std::format("cannot read baseline: {}", path); }
+    std::map<std::pair<std::string, std::string>, double> medians;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        std::string benchmark, phase;
+        std::size_t runs;
+        double median;
+        if (row >> benchmark >> phase >> runs >> median) { medians[{ benchmark, phase }] = median; }
+    }
+    return medians;
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t runs = 5;
+    bool ast = true, vm = true;
+    std::optional<std::string> baseline;
+    double threshold = 10;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        try {
+            if      (arg.starts_with("--runs="))      { runs = std::stoul(arg.substr(7)); }
+            else if (arg == "--engine=ast")           { ast = true;  vm = false; }
+            else if (arg == "--engine=vm")            { ast = false; vm = true;  }
+            else if (arg == "--engine=all")           { ast = true;  vm = true;  }
+            else if (arg.starts_with("--baseline="))  { baseline = arg.substr(11); }
+            else if (arg.starts_with("--threshold=")) { threshold = std::stod(arg.substr(12)); }
+            else if (arg.starts_with("-"))            { print_usage(); return EXIT_FAILURE; }
+            else { files.push_back(arg); }
+        } catch (std::exception const &) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (runs == 0) { print_usage(); return EXIT_FAILURE; }
+
+    // The corpus, and the large generated source
+    std::vector<std::pair<std::string, std::string>> corpus;
+    for (auto const & path : files) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) { std::cerr << "error: could not open file: " << path << std::endl; return EXIT_FAILURE; }
+        std::ostringstream text;
+        text << file.rdbuf();
+        corpus.emplace_back(std::filesystem::path(path).stem().string(), text.str());
+    }
+    corpus.emplace_back("large_file", large_source(8 << 20));
+
+    li::Builtins builtins;
+    std::vector<Result> results;
+
+    for (auto const & [name, text] : corpus) {
+        try {
+            Result parsing { name, "parse", {} };
+            forms program = parse(text, builtins);
+            for (std::size_t run = 0; run < runs; ++run) {
+                // Free the last run's program first, so it is not timed.
+                program.clear();
+                parsing.times.push_back(time_ms([&]() { program = parse(text, builtins); }));
+            }
+            results.push_back(std::move(parsing));
+
+            scripts compiled;
+            if (vm) {
+                Result compilation { name, "compile", {} };
+                compiled = compile(program);
+                for (std::size_t run = 0; run < runs; ++run) {
+                    compiled.clear();
+                    compilation.times.push_back(time_ms([&]() { compiled = compile(program); }));
+                }
+                results.push_back(std::move(compilation));
+            }
+
+            for (bool use_vm : { false, true }) {
+                if (!(use_vm ? vm : ast)) { continue; }
+                Result evaluation { name, use_vm ? "vm" : "ast", {} };
+                const scripts * script = use_vm ? &compiled : nullptr;
+                evaluate(program, script, builtins);
+                for (std::size_t run = 0; run < runs; ++run) {
+                    evaluation.times.push_back(evaluate(program, script, builtins));
+                }
+                results.push_back(std::move(evaluation));
+            }
+        } catch (std::string const & e) {
+            std::cerr << "error: " << name << ": " << e << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (auto & result : results) {
+        std::sort(result.times.begin(), result.times.end());
+        std::cout << std::format("{}\t{}\t{}\t{:.3f}\t{:.3f}\t{:.3f}", result.benchmark, result.phase,
+                                 result.times.size(), result.median(), result.times.front(), result.times.back())
+                  << std::endl;
+    }
+
+    if (!baseline) { return EXIT_SUCCESS; }
+
+    bool regressed = false;
+    try {
+        auto medians = read_baseline(*baseline);
+        for (auto const & result : results) {
+            auto it = medians.find({ result.benchmark, result.phase });
+            if (it == medians.end()) { continue; }
+            double change = (result.median() / it->second - 1) * 100;
+            bool slower = change > threshold && result.median() >= noise_ms;
+            regressed |= slower;
+            std::cerr << std::format("{:<12} {:<6} {:>10.3f} ms  (baseline {:>10.3f} ms, {:+.1f}%){}",
+                                     result.benchmark, result.phase, result.median(), it->second,
+                                     change, slower ? "  REGRESSION" : "") << std::endl;
+        }
+    } catch (std::string const & e) {
+        std::cerr << "error: " << e << std::endl;
+        return EXIT_FAILURE;
+    }
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,8 @@
+; Ackermann function: a mix of tail and nested calls.
+(define (ack m n)
+    (cond ((= m 0) (+ n 1))
+          ((= n 0) (ack (- m 1) 1))
+          (#t      (ack (- m 1) (ack m (- n 1))))))
+
+(ack 2 500)
+(ack 3 6)
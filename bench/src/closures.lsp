@@ -0,0 +1,13 @@
+; Creating and calling many short-lived closures.
+(define (make-adder n) (lambda (x) (+ x n)))
+(define (compose f g) (lambda (x) (f (g x))))
+
+(define (twice f) (compose f f))
+
+(define (loop n acc)
+    (if (= n 0)
+        acc
+        (loop (- n 1)
+              (modulo ((twice (compose (make-adder n) (make-adder 1))) acc) 1000))))
+
+(loop 100000 0)
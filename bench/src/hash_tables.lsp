@@ -0,0 +1,16 @@
+; Joining two tables on a key, through a hash table.
+(define (index i n table)
+    (if (= i n) table (begin (hash-set! table (cons i (modulo i 7)) (* i 3)) (index (+ i 1) n table))))
+
+(define (join i n table acc)
+    (if (= i n)
+        acc
+        (join (+ i 1) n table (modulo (+ acc (hash-ref table (cons i (modulo i 7)) 0)) 1000))))
+
+(define (loop k acc)
+    (if (= k 0)
+        acc
+        (let ((table (index 0 20000 (make-hash-table))))
+            (loop (- k 1) (modulo (+ acc (join 0 40000 table 0)) 1000)))))
+
+(loop 5 0)
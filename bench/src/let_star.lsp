@@ -0,0 +1,15 @@
+; Deeply nested `let*` and `let` frames, with references across them.
+(define (frames x)
+    (let* ((a (+ x 1)) (b (+ a 1)) (c (+ b a)) (d (+ c b)) (e (+ d c))
+           (f (- e d)) (g (- f c)) (h (+ g b)) (i (+ h a)) (j (- i x)))
+        (let ((k (+ a j)) (l (+ b i)))
+            (let* ((m (+ k l)) (n (- m h)) (o (+ n g)) (p (- o f)))
+                (let ((q (+ p e)) (r (- d c)))
+                    (modulo (+ a b c d e f g h i j k l m n o p q r) 1000))))))
+
+(define (loop n acc)
+    (if (= n 0)
+        acc
+        (loop (- n 1) (modulo (+ acc (frames n)) 1000))))
+
+(loop 50000 0)
@@ -0,0 +1,19 @@
+; Building, copying and walking long lists.
+(define (iota n acc)
+    (if (= n 0) acc (iota (- n 1) (cons n acc))))
+
+(define (sum lst acc)
+    (if (null? lst) acc (sum (cdr lst) (modulo (+ acc (car lst)) 1000))))
+
+(define (reverse lst acc)
+    (if (null? lst) acc (reverse (cdr lst) (cons (car lst) acc))))
+
+(define (loop n acc)
+    (if (= n 0)
+        acc
+        (let* ((a (iota 2000 ()))
+               (b (append a (reverse a ())))
+               (c (append b (list 1 2 3 4 5 6 7 8))))
+            (loop (- n 1) (modulo (+ acc (length c) (sum c 0)) 1000)))))
+
+(loop 50 0)
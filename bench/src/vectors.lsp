@@ -0,0 +1,18 @@
+; Indexed access, and the bulk vector builtins.
+(define (iota n acc)
+    (if (= n 0) acc (iota (- n 1) (cons n acc))))
+
+(define v (list->vector (iota 100000 ())))
+
+(define (sum i acc)
+    (if (= i 100000) acc (sum (+ i 1) (modulo (+ acc (vector-ref v i)) 1000))))
+
+(define (bulk n acc)
+    (if (= n 0)
+        acc
+        (let* ((w (vector-add v (vector-scale v 3)))
+               (x (+ (vector-sum w) (vector-dot v w) (vector-max w) (vector-min w))))
+            (bulk (- n 1) (modulo (+ acc x) 1000)))))
+
+(sum 0 0)
+(bulk 200 0)
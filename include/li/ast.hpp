@@ -2,9 +2,14 @@
 #define H_AST
 
 #include "li/env.hpp"
+#include "li/heap.hpp"
+#include "li/value.hpp"
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <list>
+#include <optional>
 #include <vector>
 #include <string>
 #include <memory>
@@ -14,34 +19,74 @@ namespace lisp {
 
 namespace interpreter {
 
+class Compiler;
+class ImageReader;
+class ImageWriter;
+class Optimizer;
+
+// A procedure application in tail position. Rather than being performed
+// on the C++ stack, it is handed back to the enclosing trampoline.
+struct TailCall {
+    Value proc;
+
+    value_span args() const;
+    // Copies `args`; up to `inline_args` of them are stored in place.
+    void set_args(value_span args);
+
+private:
+    static constexpr std::size_t inline_args = 8;
+
+    std::array<Value, inline_args> inline_;
+    std::vector<Value> spilled_;
+    std::size_t size_ = 0;
+};
+
+// Kinds of node, as tagged in program images
+enum class NodeTag : std::uint8_t {
+    integer,
+    boolean,
+    unit,
+    seq,
+    var,
+    bind,
+    let,
+    proc,
+    lambda,
+    pair,
+    cond,
+    and_,
+    or_,
+    bignum, // an IntNode too large for a fixnum
+};
+constexpr std::size_t node_kinds = static_cast<std::size_t>(NodeTag::bignum) + 1;
+
 class ASTNode : public std::enable_shared_from_this<ASTNode> {
 public:
     using node_ptr = std::shared_ptr<ASTNode>;
     using node_list = std::list<node_ptr>;
 
-    virtual node_ptr eval(Env & env) = 0;
+    virtual Value eval(Env & env) = 0;
     virtual std::string to_string() const = 0;
     virtual ~ASTNode() = default;
 
-    // Numeric types
-    virtual bool is_numeric() const { return false; }
-    virtual int get_numeric() const;
+    // Resolve identifiers to lexical addresses (run once, after parsing)
+    virtual void resolve(Scope &) { }
 
-    // Boolean types
-    virtual bool is_boolean() const { return false; }
-    virtual bool get_boolean() const;
+    // Evaluate in tail position. Returns `Value::tail_call()` if, instead
+    // of a value, a call was left in `tail` for the caller to perform.
+    virtual Value eval_tail(Env & env, TailCall &) { return eval(env); }
 
-    // Procedure types
-    virtual bool is_callable() const { return false; }
-    virtual node_ptr call(node_list &);
+    // Emit bytecode for this node (see vm.hpp).
+    virtual void compile(Compiler & compiler, bool tail);
 
-    // Pair types
-    virtual bool is_pair() const { return false; }
-    virtual node_ptr get(std::size_t) const;
+    // Write this node into a program image (see image.hpp).
+    virtual void save(ImageWriter & image) const;
 
-    // Unit/Null types
-    virtual bool is_unit() const { return false; }
-    virtual bool is_null() const { return false; }
+    // Simplify this node and its children (see optimize.hpp), returning
+    // the node to use in its place.
+    virtual node_ptr optimize(Optimizer & optimizer);
+    // The value of a literal, which evaluating it always gives
+    virtual std::optional<Value> literal() const { return std::nullopt; }
 
     // Identifier types
     virtual bool is_var() const { return false; }
@@ -52,54 +97,51 @@ public:
 
 class IntNode : public ASTNode {
 public:
-    IntNode(int);
-    node_ptr eval(Env & env);
+    // A fixnum, or a bignum that has been pinned (see number.hpp).
+    IntNode(Value value);
+    Value eval(Env & env);
+    std::optional<Value> literal() const override { return value_; }
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
     std::string to_string() const;
 
-    bool is_numeric() const override { return true; }
-    int get_numeric() const override;
-
 private:
-    const int value_;
+    const Value value_;
 };
 
 class BoolNode : public ASTNode {
 public:
     BoolNode(bool);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    std::optional<Value> literal() const override { return Value::boolean(value_); }
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
     std::string to_string() const;
 
-    bool is_boolean() const override { return true; }
-    bool get_boolean() const override;
-
 private:
     const bool value_;
 };
 
 class UnitNode : public ASTNode {
 public:
-    UnitNode() = default;
-    node_ptr eval(Env & env);
-    bool is_unit() const override { return true; }
-    std::string to_string() const;
-};
-
-class NullNode : public ASTNode {
-public:
-    NullNode() = default;
-    NullNode(std::string msg);
-    node_ptr eval(Env & /* env */);
-    bool is_null() const override { return true; }
+    UnitNode();
+    Value eval(Env & env);
+    std::optional<Value> literal() const override { return Value::unit(); }
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
     std::string to_string() const;
-private:
-    std::string msg_ = "";
 };
 
 class SeqNode : public ASTNode {
 public:
     SeqNode() = default;
     SeqNode(node_list && seq);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
     node_list sequence_;
@@ -108,20 +150,38 @@ public:
 class VarNode : public ASTNode {
 public:
     VarNode(std::string name);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
     std::string to_string() const;
 
     bool is_var() const override { return true; }
     std::string get_identifier() const override;
+    // Builtin procedure the name refers to, if it is not bound locally
+    const Value & builtin() const { return builtin_; }
 
 private:
+    friend class ImageReader;
+
     std::string name_;
+    // Set by the resolver for locally bound names; otherwise the
+    // name is looked up in the top-level and builtin environments.
+    bool local_ = false;
+    Env::address addr_ = {};
+    // Builtin procedure the name refers to, unless defined at top level
+    Value builtin_;
+    GlobalCache cache_;
 };
 
 class BindNode : public ASTNode {
 public:
     BindNode(std::string name, node_ptr value);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
@@ -132,7 +192,12 @@ private:
 class LetNode : public ASTNode {
 public:
     LetNode(std::vector<Env::kv_pair> && bd, node_ptr node, bool star = false);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
@@ -141,60 +206,100 @@ private:
     bool star_;
 };
 
+// A call of a pure builtin on literals, evaluated by the optimizer (see
+// optimize.hpp). The call is kept, and run instead of using the result
+// once any builtin has been redefined.
+class FoldNode : public ASTNode {
+public:
+    // `value` is a fixnum, a pinned bignum or a boolean.
+    FoldNode(Value value, node_ptr call);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    std::string to_string() const;
+
+    const Value & value() const { return value_; }
+
+private:
+    const Value value_;
+    node_ptr call_;
+};
+
 // Calling a procedure
 class ProcNode : public ASTNode {
 public:
     ProcNode(node_list && nodes);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
     node_list nodes_;
 };
 
-class BuiltinNode : public ASTNode {
+// A `lambda` expression. Evaluating it creates a Closure.
+class LambdaNode : public ASTNode {
 public:
-    using builtin_fxn = std::function<node_ptr(node_list &)>;
-
-    BuiltinNode(const std::string, const builtin_fxn &);
-    node_ptr eval(Env & env);
-    node_ptr call(node_list &) override;
+    // A `recursive` lambda binds its own name in its frame, for calls
+    // from the body; otherwise the name is only for printing and
+    // profiling, and is looked up like any other (see `define-memo`).
+    LambdaNode(std::vector<std::string> && arg_list, node_ptr body, std::string name = "", bool recursive = true);
+    // Name of a procedure made by `define` (empty otherwise)
+    const std::string & name() const { return name_; }
+    bool binds_self() const { return recursive_ && !name_.empty(); }
+    Value eval(Env & env);
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
-    bool is_callable() const override { return true; }
-
 private:
-    const std::string name_;
-    const builtin_fxn fxn_;
+    friend class Closure;
+    friend class ImageReader;
+
+    const std::vector<std::string> arg_list_;
+    node_ptr body_;
+    // Interned, so that profile samples can keep it past the node.
+    const std::string & name_;
+    const bool recursive_;
+    // Where each free variable of the body lives when the lambda is evaluated
+    std::vector<Env::address> captures_;
 };
 
-class LambdaNode : public ASTNode {
+// Runtime procedure: a lambda plus the values of its free variables.
+class Closure : public Object {
 public:
-    LambdaNode(std::vector<std::string> && arg_list, node_ptr body, std::string name = "");
-    node_ptr eval(Env & env);
-    node_ptr call(node_list &) override;
-    std::string to_string() const;
+    Closure(std::shared_ptr<const LambdaNode> lambda, const Env & env, std::vector<Value> && captured);
+    Value call(value_span args) override;
+    Value call_tail(value_span args, TailCall & tail) override;
+    std::string to_string() const override;
+    void trace(Heap & heap) const override;
 
     bool is_callable() const override { return true; }
 
 private:
-    const std::vector<std::string> arg_list_;
-    node_ptr body_;
+    std::shared_ptr<const LambdaNode> lambda_;
+    std::vector<Value> captured_;
     Env env_;
-    std::string name_;
 };
 
+// `cons` (and `list`, which is parsed into nested `cons`es)
 class PairNode : public ASTNode {
 public:
     PairNode(node_ptr l, node_ptr r);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
-    bool is_pair() const override { return true; }
-    node_ptr get(std::size_t) const override;
-protected:
-    // Support special printing of lists
-    std::string to_string_internal(bool outer = true) const;
 private:
     node_ptr first_;
     node_ptr second_;
@@ -203,7 +308,12 @@ private:
 class CondNode : public ASTNode {
 public:
     CondNode(node_list && p_seq, node_list && n_seq);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
@@ -214,25 +324,37 @@ private:
 class AndNode : public ASTNode {
 public:
     AndNode(node_list && nodes);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
+    friend class Optimizer;
+
     node_list nodes_;
 };
 
 class OrNode : public ASTNode {
 public:
     OrNode(node_list && nodes);
-    node_ptr eval(Env & env);
+    Value eval(Env & env);
+    Value eval_tail(Env & env, TailCall & tail) override;
+    void resolve(Scope & scope) override;
+    void compile(Compiler & compiler, bool tail) override;
+    void save(ImageWriter & image) const override;
+    node_ptr optimize(Optimizer & optimizer) override;
     std::string to_string() const;
 
 private:
+    friend class Optimizer;
+
     node_list nodes_;
 };
 
-bool is_list(node_ptr node);
-
 }
 
 }
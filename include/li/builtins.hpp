@@ -2,6 +2,13 @@
 #define H_BUILTINS
 
 #include "li/ast.hpp"
+#include "li/hash.hpp"
+#include "li/heap.hpp"
+#include "li/kernels.hpp"
+#include "li/memo.hpp"
+#include "li/number.hpp"
+#include "li/output.hpp"
+#include "li/stats.hpp"
 
 #include <functional>
 
@@ -9,210 +16,406 @@ namespace lisp {
 
 namespace interpreter {
 
+// `((name . count) ...)`, in the order of `counts`, with each name a symbol
+inline Value counts_list(const std::vector<std::pair<std::string, std::size_t>> & counts)
+{
+	Value list = Value::unit();
+	for (auto it = counts.rbegin(); it != counts.rend(); ++it) {
+		list = make_object<Pair>(make_object<Pair>(symbol(it->first), integer(it->second)), list);
+	}
+	return list;
+}
+
 struct Builtins {
-	using arg_list = ASTNode::node_list;
-	const std::unordered_map<std::string, BuiltinNode::builtin_fxn> functions = {
+	// One procedure object per builtin, shared by every reference to it
+	Builtins()
+	{
+		for (auto const & [name, fxn] : functions) {
+			procedures.emplace(name, make_object<Builtin>(name, fxn));
+		}
+		heap().add_root(&procedures);
+	}
+	Builtins(const Builtins &) = delete;
+	~Builtins() { heap().remove_root(&procedures); }
+
+	using arg_list = value_span;
+	const std::unordered_map<std::string, builtin_fxn> functions = {
 		// Integers
-		{"*", [](arg_list & args){
+		{"*", [](arg_list args){
 			enforce_all_numeric("*", args);
-			return std::make_unique<IntNode>(
-				std::accumulate(args.cbegin(), args.cend(), 1, [](int a, const auto & b){
-					return a * b->get_numeric();
-				})
-			);
+			Value product = Value::number(1);
+			for (auto const & arg : args) { product = multiply(product, arg); }
+			return product;
 		}},
-		{"+", [](arg_list & args){
+		{"+", [](arg_list args){
+			if (args.size() >= kernel_min_args) {
+				if (auto sum = kernels().sum(args)) { return integer(*sum); }
+			}
 			enforce_all_numeric("+", args);
-			return std::make_unique<IntNode>(
-				std::accumulate(args.cbegin(), args.cend(), 0, [](int a, const auto & b){
-					return a + b->get_numeric();
-				})
-			);
+			Value sum = Value::number(0);
+			for (auto const & arg : args) { sum = add(sum, arg); }
+			return sum;
 		}},
-		{"-", [](arg_list & args){
+		{"-", [](arg_list args){
 			enforce_min_arg_count("-", args, 1);
 			enforce_all_numeric("-", args);
-			return std::make_unique<IntNode>(
-				std::accumulate(std::next(args.cbegin()), args.cend(), args.front()->get_numeric(), [](int a, const auto & b){
-					return a - b->get_numeric();
-				})
-			);
+			Value difference = args.front();
+			for (auto const & arg : args.subspan(1)) { difference = subtract(difference, arg); }
+			return difference;
 		}},
-		{"/", [](arg_list & args){
+		{"/", [](arg_list args){
 			enforce_min_arg_count("/", args, 1);
 			enforce_all_numeric("/", args);
-			return std::make_unique<IntNode>(
-				std::accumulate(std::next(args.cbegin()), args.cend(), args.front()->get_numeric(), [](int a, const auto & b){
-					if ( b->get_numeric() == 0) { throw_error("runtime: division by zero"); } 
-					return a / b->get_numeric();
-				})
-			);
+			Value result = args.front();
+			for (auto const & arg : args.subspan(1)) { result = quotient(result, arg); }
+			return result;
 		}},
 
-		{"max", [](arg_list & args){
+		{"max", [](arg_list args){
+			if (args.size() >= kernel_min_args) {
+				if (auto max = kernels().max(args)) { return Value::number(*max); }
+			}
 			enforce_all_numeric("max", args);
 			enforce_min_arg_count("max", args, 1);
-			return std::make_unique<IntNode>(
-				(*std::max_element(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() < b->get_numeric();
-				}))->get_numeric()
-			);
+			return *std::max_element(args.begin(), args.end(), [](const auto & a, const auto & b){
+				return compare(a, b) < 0;
+			});
 		}},
-		{"min", [](arg_list & args){
+		{"min", [](arg_list args){
+			if (args.size() >= kernel_min_args) {
+				if (auto min = kernels().min(args)) { return Value::number(*min); }
+			}
 			enforce_all_numeric("min", args);
 			enforce_min_arg_count("min", args, 1);
-			return std::make_unique<IntNode>(
-				(*std::min_element(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() < b->get_numeric();
-				}))->get_numeric()
-			);
+			return *std::min_element(args.begin(), args.end(), [](const auto & a, const auto & b){
+				return compare(a, b) < 0;
+			});
 		}},
 
-		{"=", [](arg_list & args){
+		{"=", [](arg_list args){
 			enforce_all_numeric("=", args);
-			return std::make_unique<BoolNode>(
-				(std::adjacent_find(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() != b->get_numeric();
-				})) == args.cend()
+			return Value::boolean(
+				(std::adjacent_find(args.begin(), args.end(), [](const auto & a, const auto & b){
+						return compare(a, b) != 0;
+				})) == args.end()
 			);
 		}},
-		{"<", [](arg_list & args){
+		{"<", [](arg_list args){
 			enforce_all_numeric("<", args);
-			return std::make_unique<BoolNode>(
-				(std::adjacent_find(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() >= b->get_numeric();
-				})) == args.cend()
+			return Value::boolean(
+				(std::adjacent_find(args.begin(), args.end(), [](const auto & a, const auto & b){
+						return compare(a, b) >= 0;
+				})) == args.end()
 			);
 		}},
-		{">", [](arg_list & args){
+		{">", [](arg_list args){
 			enforce_all_numeric(">", args);
-			return std::make_unique<BoolNode>(
-				(std::adjacent_find(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() <= b->get_numeric();
-				})) == args.cend()
+			return Value::boolean(
+				(std::adjacent_find(args.begin(), args.end(), [](const auto & a, const auto & b){
+						return compare(a, b) <= 0;
+				})) == args.end()
 			);
 		}},
-		{"<=", [](arg_list & args){
+		{"<=", [](arg_list args){
 			enforce_all_numeric("<=", args);
-			return std::make_unique<BoolNode>(
-				(std::adjacent_find(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() > b->get_numeric();
-				})) == args.cend()
+			return Value::boolean(
+				(std::adjacent_find(args.begin(), args.end(), [](const auto & a, const auto & b){
+						return compare(a, b) > 0;
+				})) == args.end()
 			);
 		}},
-		{">=", [](arg_list & args){
+		{">=", [](arg_list args){
 			enforce_all_numeric(">=", args);
-			return std::make_unique<BoolNode>(
-				(std::adjacent_find(args.cbegin(), args.cend(), [](const auto & a, const auto & b){
-						return a->get_numeric() < b->get_numeric();
-				})) == args.cend()
+			return Value::boolean(
+				(std::adjacent_find(args.begin(), args.end(), [](const auto & a, const auto & b){
+						return compare(a, b) < 0;
+				})) == args.end()
 			);
 		}},
 
-		{"abs", [](arg_list & args){
+		{"abs", [](arg_list args){
 			enforce_arg_exact_count("abs", args, 1);
 			enforce_all_numeric("abs", args);
-			return std::make_unique<IntNode>(
-				std::abs(args.front()->get_numeric())
-			);
+			return compare(args.front(), Value::number(0)) < 0 ? negate(args.front()) : args.front();
 		}},
-		{"expt", [](arg_list & args){
+		{"expt", [](arg_list args){
 			enforce_arg_exact_count("expt", args, 2);
 			enforce_all_numeric("expt", args);
-			return std::make_unique<IntNode>(
-				std::pow(args.front()->get_numeric(),
-					     args.back()->get_numeric())
-			);
+			return expt(args.front(), args.back());
 		}},
-		{"modulo", [](arg_list & args){
+		{"modulo", [](arg_list args){
 			enforce_arg_exact_count("modulo", args, 2);
 			enforce_all_numeric("modulo", args);
-			if (args.back()->get_numeric() == 0) { throw_error("runtime: division by zero"); }
-			return std::make_unique<IntNode>(
-				args.front()->get_numeric() % args.back()->get_numeric()
-			);
+			return remainder(args.front(), args.back());
 		}},
-		{"zero?", [](arg_list & args){
+		{"zero?", [](arg_list args){
 			enforce_arg_exact_count("zero?", args, 1);
 			enforce_all_numeric("zero?", args);
-			return std::make_unique<BoolNode>(
-				args.front()->get_numeric() == 0
+			// Zero is always a fixnum.
+			return Value::boolean(
+				args.front().is_fixnum() && args.front().fixnum() == 0
 			);
 		}},
 		// Pairs
-		{"car", [](arg_list & args){
+		{"car", [](arg_list args){
 			enforce_arg_exact_count("car", args, 1);
-			return args.front()->get(0);
+			return args.front().get(0);
 		}},
-		{"cdr", [](arg_list & args){
+		{"cdr", [](arg_list args){
 			enforce_arg_exact_count("cdr", args, 1);
-			return args.front()->get(1);
+			return args.front().get(1);
 		}},
 		// Lists
-		{"length", [](arg_list & args){
+		{"length", [](arg_list args){
 			enforce_arg_exact_count("length", args, 1);
 			enforce_all_list("length", args);
 
-			std::function<std::size_t(const node_ptr, std::size_t)> get_length = [&get_length](const node_ptr node, std::size_t count){
-				if (node->is_unit()) { return count; }
-				return get_length(node->get(1), count + 1);
-			};
+			int length = 0;
+			for (Value node = args.front(); !node.is_unit(); node = node.get(1)) { ++length; }
 
-			return std::make_unique<IntNode>(get_length(args.front(), 0));
+			return Value::number(length);
 		}},
-		{"append", [](arg_list & args){
+		{"append", [](arg_list args){
 			enforce_arg_exact_count("append", args, 2);
 			enforce_all_list("append", args);
 
-			std::function<node_ptr(node_ptr, node_ptr)>
-			concat = [&concat](node_ptr l, node_ptr r){
-				if (l->is_unit()) { return r; }
-				return std::dynamic_pointer_cast<ASTNode>(std::make_shared<PairNode>(l->get(0), concat(l->get(1), r)));
+			std::function<Value(const Value &, const Value &)>
+			concat = [&concat](const Value & l, const Value & r){
+				if (l.is_unit()) { return r; }
+				return make_object<Pair>(l.get(0), concat(l.get(1), r));
 			};
 
 			return concat(args.front(), args.back());
 		}},
+		// Vectors
+		{"make-vector", [](arg_list args){
+			enforce_min_arg_count("make-vector", args, 1);
+			assert_throw("make-vector", "expected at most 2 args", args.size() <= 2);
+			assert_throw("make-vector", "length must be an integer", args.front().is_numeric());
+			int length = args.front().get_numeric();
+			assert_throw("make-vector", "length must not be negative", length >= 0);
+			return make_object<Vector>(length, args.size() == 2 ? args.back() : Value::number(0));
+		}},
+		{"vector", [](arg_list args){
+			return make_object<Vector>(std::vector<Value>(args.begin(), args.end()));
+		}},
+		{"vector-length", [](arg_list args){
+			enforce_arg_exact_count("vector-length", args, 1);
+			return Value::number(static_cast<int>(enforce_vector("vector-length", args.front()).size()));
+		}},
+		{"vector-ref", [](arg_list args){
+			enforce_arg_exact_count("vector-ref", args, 2);
+			auto & vector = enforce_vector("vector-ref", args.front());
+			return vector[enforce_index("vector-ref", args.back(), vector.size())];
+		}},
+		{"vector-set!", [](arg_list args){
+			enforce_arg_exact_count("vector-set!", args, 3);
+			auto & vector = enforce_vector("vector-set!", args.front());
+			vector[enforce_index("vector-set!", args[1], vector.size())] = args.back();
+			return Value();
+		}},
+		{"vector->list", [](arg_list args){
+			enforce_arg_exact_count("vector->list", args, 1);
+			auto & vector = enforce_vector("vector->list", args.front());
+			Value list = Value::unit();
+			for (std::size_t i = vector.size(); i-- > 0;) { list = make_object<Pair>(vector[i], list); }
+			return list;
+		}},
+		{"list->vector", [](arg_list args){
+			enforce_arg_exact_count("list->vector", args, 1);
+			enforce_all_list("list->vector", args);
+			std::vector<Value> elements;
+			for (Value node = args.front(); !node.is_unit(); node = node.get(1)) { elements.push_back(node.get(0)); }
+			return make_object<Vector>(std::move(elements));
+		}},
+		// Numeric vectors: the kernels when they can, else generic arithmetic
+		{"vector-sum", [](arg_list args){
+			enforce_arg_exact_count("vector-sum", args, 1);
+			auto elements = enforce_vector("vector-sum", args.front()).elements();
+			if (auto sum = kernels().sum(elements)) { return integer(*sum); }
+			enforce_all_numeric("vector-sum", elements);
+			Value sum = Value::number(0);
+			for (auto const & element : elements) { sum = add(sum, element); }
+			return sum;
+		}},
+		{"vector-min", [](arg_list args){
+			enforce_arg_exact_count("vector-min", args, 1);
+			auto elements = enforce_vector("vector-min", args.front()).elements();
+			assert_throw("vector-min", "vector must not be empty", !elements.empty());
+			if (auto min = kernels().min(elements)) { return Value::number(*min); }
+			enforce_all_numeric("vector-min", elements);
+			return *std::min_element(elements.begin(), elements.end(), [](const auto & a, const auto & b){
+				return compare(a, b) < 0;
+			});
+		}},
+		{"vector-max", [](arg_list args){
+			enforce_arg_exact_count("vector-max", args, 1);
+			auto elements = enforce_vector("vector-max", args.front()).elements();
+			assert_throw("vector-max", "vector must not be empty", !elements.empty());
+			if (auto max = kernels().max(elements)) { return Value::number(*max); }
+			enforce_all_numeric("vector-max", elements);
+			return *std::max_element(elements.begin(), elements.end(), [](const auto & a, const auto & b){
+				return compare(a, b) < 0;
+			});
+		}},
+		{"vector-add", [](arg_list args){
+			enforce_arg_exact_count("vector-add", args, 2);
+			auto a = enforce_vector("vector-add", args.front()).elements();
+			auto b = enforce_vector("vector-add", args.back()).elements();
+			assert_throw("vector-add", "vectors must have the same length", a.size() == b.size());
+			std::vector<Value> sum(a.size());
+			if (!kernels().add(a, b, sum.data())) {
+				enforce_all_numeric("vector-add", a);
+				enforce_all_numeric("vector-add", b);
+				for (std::size_t i = 0; i < a.size(); ++i) { sum[i] = add(a[i], b[i]); }
+			}
+			return make_object<Vector>(std::move(sum));
+		}},
+		{"vector-scale", [](arg_list args){
+			enforce_arg_exact_count("vector-scale", args, 2);
+			auto elements = enforce_vector("vector-scale", args.front()).elements();
+			const Value & factor = args.back();
+			assert_throw("vector-scale", "factor must be an integer", factor.is_numeric());
+			std::vector<Value> product(elements.size());
+			if (!factor.is_fixnum() || !kernels().scale(elements, factor.fixnum(), product.data())) {
+				enforce_all_numeric("vector-scale", elements);
+				for (std::size_t i = 0; i < elements.size(); ++i) { product[i] = multiply(elements[i], factor); }
+			}
+			return make_object<Vector>(std::move(product));
+		}},
+		{"vector-dot", [](arg_list args){
+			enforce_arg_exact_count("vector-dot", args, 2);
+			auto a = enforce_vector("vector-dot", args.front()).elements();
+			auto b = enforce_vector("vector-dot", args.back()).elements();
+			assert_throw("vector-dot", "vectors must have the same length", a.size() == b.size());
+			if (auto dot = kernels().dot(a, b)) { return integer(*dot); }
+			enforce_all_numeric("vector-dot", a);
+			enforce_all_numeric("vector-dot", b);
+			Value dot = Value::number(0);
+			for (std::size_t i = 0; i < a.size(); ++i) { dot = add(dot, multiply(a[i], b[i])); }
+			return dot;
+		}},
+		// Hash tables
+		{"make-hash-table", [](arg_list args){
+			enforce_arg_exact_count("make-hash-table", args, 0);
+			return make_object<HashTable>();
+		}},
+		{"hash-ref", [](arg_list args){
+			enforce_min_arg_count("hash-ref", args, 2);
+			assert_throw("hash-ref", "expected at most 3 args", args.size() <= 3);
+			auto const * value = enforce_hash_table("hash-ref", args.front()).find(args[1]);
+			if (value) { return *value; }
+			assert_throw("hash-ref", "no value for key " + args[1].to_string(), args.size() == 3);
+			return args.back();
+		}},
+		{"hash-set!", [](arg_list args){
+			enforce_arg_exact_count("hash-set!", args, 3);
+			enforce_hash_table("hash-set!", args.front()).insert(args[1], args.back());
+			return Value();
+		}},
+		{"hash-remove!", [](arg_list args){
+			enforce_arg_exact_count("hash-remove!", args, 2);
+			enforce_hash_table("hash-remove!", args.front()).erase(args.back());
+			return Value();
+		}},
+		{"hash-count", [](arg_list args){
+			enforce_arg_exact_count("hash-count", args, 1);
+			return Value::number(static_cast<int>(enforce_hash_table("hash-count", args.front()).size()));
+		}},
+		{"hash-keys", [](arg_list args){
+			enforce_arg_exact_count("hash-keys", args, 1);
+			Value list = Value::unit();
+			enforce_hash_table("hash-keys", args.front()).for_each([&](const Value & key, const Value &) {
+				list = make_object<Pair>(key, list);
+			});
+			return list;
+		}},
+		{"hash->list", [](arg_list args){
+			enforce_arg_exact_count("hash->list", args, 1);
+			Value list = Value::unit();
+			enforce_hash_table("hash->list", args.front()).for_each([&](const Value & key, const Value & value) {
+				list = make_object<Pair>(make_object<Pair>(key, value), list);
+			});
+			return list;
+		}},
+		// Memoization
+		{"memoize", [](arg_list args){
+			enforce_min_arg_count("memoize", args, 1);
+			assert_throw("memoize", "expected at most 2 args", args.size() <= 2);
+			assert_throw("memoize", "argument must be a procedure", args.front().is_callable());
+			int capacity = 0;
+			if (args.size() == 2) {
+				assert_throw("memoize", "size must be an integer", args.back().is_numeric());
+				capacity = args.back().get_numeric();
+				assert_throw("memoize", "size must be positive", capacity > 0);
+			}
+			return make_object<Memo>(args.front(), capacity);
+		}},
+		{"memo-stats", [](arg_list args){
+			enforce_arg_exact_count("memo-stats", args, 1);
+			auto const & memo = enforce_memo("memo-stats", args.front());
+			return counts_list({ { "hits", memo.hits() }, { "misses", memo.misses() }, { "size", memo.size() } });
+		}},
 		// Other
-		{"display", [](arg_list & args){
+		{"display", [](arg_list args){
 			enforce_arg_exact_count("display", args, 1);
-			std::cout << *args.front() << std::flush;
-			return std::make_unique<NullNode>();
+			output() << args.front();
+			return Value();
 		}},
-		{"newline", [](arg_list & args){
+		{"newline", [](arg_list args){
 			enforce_arg_exact_count("newline", args, 0);
-			std::cout << std::endl;
-			return std::make_unique<NullNode>();
+			output() << '\n';
+			return Value();
 		}},
-		{"not", [](arg_list & args){
+		{"flush-output", [](arg_list args){
+			enforce_arg_exact_count("flush-output", args, 0);
+			output().flush();
+			return Value();
+		}},
+		{"runtime-stats", [](arg_list args){
+			enforce_arg_exact_count("runtime-stats", args, 0);
+
+			return counts_list(runtime_stats_table());
+		}},
+		{"not", [](arg_list args){
 			enforce_arg_exact_count("newline", args, 1);
-			return std::make_unique<BoolNode>(!args.front()->get_boolean());
+			return Value::boolean(!args.front().get_boolean());
 		}},
 		// Types
-		{"boolean?", [](arg_list & args){
+		{"boolean?", [](arg_list args){
 			enforce_arg_exact_count("boolean?", args, 1);
-			return std::make_unique<BoolNode>(args.front()->is_boolean());
+			return Value::boolean(args.front().is_boolean());
 		}},
-		{"integer?", [](arg_list & args){
+		{"integer?", [](arg_list args){
 			enforce_arg_exact_count("integer?", args, 1);
-			return std::make_unique<BoolNode>(args.front()->is_numeric());
+			return Value::boolean(args.front().is_numeric());
 		}},
-		{"pair?", [](arg_list & args){
+		{"pair?", [](arg_list args){
 			enforce_arg_exact_count("pair?", args, 1);
-			return std::make_unique<BoolNode>(args.front()->is_pair());
+			return Value::boolean(args.front().is_pair());
 		}},
-		{"list?", [](arg_list & args){
+		{"list?", [](arg_list args){
 			enforce_arg_exact_count("list?", args, 1);
-			return std::make_unique<BoolNode>(is_list(args.front()));
+			return Value::boolean(is_list(args.front()));
+		}},
+		{"vector?", [](arg_list args){
+			enforce_arg_exact_count("vector?", args, 1);
+			return Value::boolean(args.front().is_vector());
+		}},
+		{"hash-table?", [](arg_list args){
+			enforce_arg_exact_count("hash-table?", args, 1);
+			return Value::boolean(args.front().is_hash_table());
 		}},
-		{"procedure?", [](arg_list & args){
+		{"procedure?", [](arg_list args){
 			enforce_arg_exact_count("procedure?", args, 1);
-			return std::make_unique<BoolNode>(args.front()->is_callable());
+			return Value::boolean(args.front().is_callable());
 		}},
-		{"null?", [](arg_list & args){
+		{"null?", [](arg_list args){
 			enforce_arg_exact_count("null?", args, 1);
-			return std::make_unique<BoolNode>(args.front()->is_unit());
+			return Value::boolean(args.front().is_unit());
 		}},
 	};
+	std::unordered_map<std::string, Value> procedures;
 };
 
 }
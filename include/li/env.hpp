@@ -2,6 +2,7 @@
 #define H_ENV
 
 #include "li/utility.hpp"
+#include "li/value.hpp"
 
 #include <forward_list>
 #include <utility>
@@ -14,6 +15,8 @@
 #include <algorithm>
 #include <numeric>
 #include <list>
+#include <vector>
+#include <optional>
 
 namespace lisp {
 
@@ -22,32 +25,117 @@ namespace interpreter {
 class ASTNode;
 using node_ptr = std::shared_ptr<ASTNode>;
 using node_list = std::list<node_ptr>;
-class BuiltinNode;
-using builtin_fxn = std::function<node_ptr(node_list &)>;
+using builtin_fxn = Builtin::builtin_fxn;
+class HashTable;
+class Memo;
 
 // Enforcing constrains for builtin functions
-void enforce_arg_exact_count(const char * fname, node_list & args, std::size_t count);
-void enforce_min_arg_count(const char * fname, node_list & args, std::size_t count);
-void enforce_all_numeric(const char * fname, node_list & args);
-void enforce_all_boolean(const char * fname, node_list & args);
-void enforce_all_list(const char * fname, node_list & args);
+void enforce_arg_exact_count(const char * fname, value_span args, std::size_t count);
+void enforce_min_arg_count(const char * fname, value_span args, std::size_t count);
+void enforce_all_numeric(const char * fname, value_span args);
+void enforce_all_boolean(const char * fname, value_span args);
+void enforce_all_list(const char * fname, value_span args);
+Vector & enforce_vector(const char * fname, const Value & value);
+HashTable & enforce_hash_table(const char * fname, const Value & value);
+Memo & enforce_memo(const char * fname, const Value & value);
+// `index`, if it is a valid index into a vector of `size` elements
+std::size_t enforce_index(const char * fname, const Value & index, std::size_t size);
+
+// Where a reference to a top-level or builtin name found its value last.
+// Definitions are never removed, and redefining a name assigns to the slot
+// it already has, so only a new name can make the slot stale. Defining one
+// changes the version of the top level, and the next lookup through the
+// cache starts over.
+struct GlobalCache {
+	const Value * slot = nullptr;
+	std::size_t version = 0;
+	bool builtin = false;
+};
 
 class Env {
 public:
 	using kv_pair = std::pair<const std::string, node_ptr>;
 
+	// Lexical address of a local binding. Either a slot in one of the
+	// running procedure's frames (`depth` frames out from the innermost),
+	// or an entry in the running closure's captured variables.
+	struct address {
+		bool captured;
+		std::size_t depth;
+		std::size_t slot;
+	};
+
 	Env() = default;
-	Env(std::unordered_map<std::string, node_ptr> * tl, const std::unordered_map<std::string, builtin_fxn> * bt);
-	void insert(std::string name, node_ptr value, bool top);
-	node_ptr find(const std::string name);
+	Env(std::unordered_map<std::string, Value> * tl, const std::unordered_map<std::string, Value> * bt);
+
+	// Environment for the body of a closure: same globals, no frames.
+	Env capture(const std::vector<Value> & captured) const;
+
+	// Local frames (`let`s and procedure calls). Slots are pushed on the
+	// heap's root stack; the new frame's Env must not outlive this one,
+	// and the caller pops the slots when the frame is done with.
+	Env push_frame() const;
+	void bind(Value value);
+	const Value & lookup(const address & addr) const;
+
+	// Top-level and built-in bindings
+	void define(const std::string & name, Value value);
+	Value find(const std::string & name) const;
+	// As `find`, for a name the resolver bound to `builtin` (null if none):
+	// only a top-level definition can take precedence over it. Looked up
+	// through the cache of the reference (see `GlobalCache`).
+	const Value & find(const std::string & name, const Value & builtin, GlobalCache & cache) const;
+	// Whether a builtin has been defined over at top level. Until one
+	// is, results the optimizer computed from builtins hold.
+	static bool builtin_redefined() { return builtin_redefined_; }
 
 private:
-	// Constructed Environment
-	std::unordered_map<std::string, node_ptr> bindings_;
+	static inline bool builtin_redefined_ = false;
+	// Changes whenever a name is first defined, and for each new top level
+	static inline std::size_t version_ = 1;
+
+	// Innermost frame: where its slots start on the root stack, and
+	// the Env of the frame it was created in.
+	std::size_t base_ = 0;
+	const Env * parent_ = nullptr;
+	// Free variables of the running closure
+	const std::vector<Value> * captured_ = nullptr;
 	// Top-Level
-	std::unordered_map<std::string, node_ptr> * toplvl_;
-	// Built-in functions
-	const std::unordered_map<std::string, builtin_fxn> * builtins_;
+	std::unordered_map<std::string, Value> * toplvl_ = nullptr;
+	// Built-in procedures
+	const std::unordered_map<std::string, Value> * builtins_ = nullptr;
+};
+
+// Compile-time mirror of the local frames an `Env` will hold at runtime.
+// Used by the resolver to turn identifiers into lexical addresses, and
+// to find the free variables each lambda has to capture.
+class Scope {
+public:
+	Scope(const std::unordered_map<std::string, Value> * builtins = nullptr);
+
+	void push_frame();
+	void pop_frame();
+	void declare(const std::string & name);
+	std::optional<Env::address> lookup(const std::string & name);
+	// Procedure object of a builtin (null if `name` is not one)
+	Value builtin(const std::string & name) const;
+
+	// Enter a lambda body (with an empty first frame). On exit, returns
+	// where each of its captured variables lives in the enclosing scope.
+	void push_function();
+	std::vector<Env::address> pop_function();
+
+private:
+	struct Function {
+		std::vector<std::vector<std::string>> frames;
+		std::vector<std::string> captured;
+		std::vector<Env::address> sources;
+	};
+
+	std::optional<Env::address> lookup(std::size_t fn, const std::string & name);
+
+	std::vector<Function> functions_;
+	const std::unordered_map<std::string, Value> * builtins_;
 };
 
 }
@@ -0,0 +1,77 @@
+#ifndef H_HASH
+#define H_HASH
+
+#include "li/value.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Keys are equal if they are the same integer, boolean or name, or pairs
+// of equal keys (so lists are compared element by element); any other
+// object (procedures, vectors, tables) only equals itself.
+bool equal_keys(const Value & a, const Value & b);
+std::uint64_t hash_key(const Value & key);
+
+// Hash table with open addressing: entries are stored inline in a single
+// array, and a key is looked for by linear probing from its hash. Removed
+// entries leave a marker that probing skips, until the next rehash.
+class HashTable : public Object {
+public:
+    HashTable();
+    std::string to_string() const override;
+
+    bool is_hash_table() const override { return true; }
+    void trace(Heap & heap) const override;
+    std::size_t owned_size() const override { return slots_.capacity() * sizeof(Slot); }
+
+    // The value of `key`, or nullptr if it has none
+    const Value * find(const Value & key) const;
+    void insert(const Value & key, const Value & value);
+    // False if `key` had no value
+    bool erase(const Value & key);
+    std::size_t size() const { return count_; }
+
+    // Call `f(key, value)` for every entry, in no particular order
+    template <typename F>
+    void for_each(F && f) const
+    {
+        for (auto const & slot : slots_) {
+            if (slot.hash >= first_hash) { f(slot.key, slot.value); }
+        }
+    }
+
+private:
+    // Hashes of the keys are kept, to skip most comparisons and to
+    // rehash without hashing keys again. Two values are reserved to
+    // mark free slots.
+    static constexpr std::uint64_t empty = 0;
+    static constexpr std::uint64_t removed = 1;
+    static constexpr std::uint64_t first_hash = 2;
+    static constexpr std::size_t initial_capacity = 8;
+
+    struct Slot {
+        Value key;
+        Value value;
+        std::uint64_t hash = empty;
+    };
+
+    // Where `key` is, or else the slot it would go in
+    std::size_t probe(const Value & key, std::uint64_t hash) const;
+    // Make room for one more entry
+    void reserve();
+
+    std::vector<Slot> slots_; // a power of two of them
+    std::size_t count_ = 0;   // entries
+    std::size_t used_ = 0;    // entries and removed markers
+};
+
+}
+
+}
+
+#endif
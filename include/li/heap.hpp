@@ -0,0 +1,123 @@
+#ifndef H_HEAP
+#define H_HEAP
+
+#include "li/utility.hpp"
+#include "li/value.hpp"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Owner of every Object, reclaimed by a precise mark-sweep collector.
+//
+// Objects are only reachable through roots: the root stack (frames and
+// temporaries of the tree-walking evaluator), the stacks and maps
+// registered with `add_root` (VM stack, top-level bindings), and
+// whatever is reachable from those. Collection only happens at a
+// `safepoint`; code between safepoints may hold Values in C++ locals,
+// but anything that must survive a procedure call has to be on a root.
+class Heap {
+public:
+    struct Stats {
+        std::size_t collections = 0;
+        double total_pause_ms = 0;
+        double max_pause_ms = 0;
+        std::size_t allocated = 0;   // bytes, over the whole run
+        std::size_t objects = 0;     // allocated, over the whole run
+        std::size_t freed = 0;       // bytes
+        std::size_t live = 0;        // bytes, as of now
+    };
+
+    Heap() { stack_.reserve(stack_capacity); }
+    Heap(const Heap &) = delete;
+    Heap & operator=(const Heap &) = delete;
+    ~Heap();
+
+    template <typename T, typename... Args>
+    Value make(Args &&... args)
+    {
+        T * object = new T(std::forward<Args>(args)...);
+        track(object, sizeof(T) + object->owned_size());
+        return Value(object);
+    }
+
+    // Roots
+    std::vector<Value> & stack() { return stack_; }
+    // Push onto the root stack. It never reallocates, so spans of its
+    // values stay valid until they are popped.
+    void push(Value value)
+    {
+        if (stack_.size() == stack_capacity) { throw_error("runtime: stack overflow"); }
+        stack_.push_back(value);
+    }
+    void add_root(const std::vector<Value> * values);
+    void add_root(const std::unordered_map<std::string, Value> * values);
+    void remove_root(const std::vector<Value> * values);
+    void remove_root(const std::unordered_map<std::string, Value> * values);
+
+    // Account for `object` now taking `size` bytes, for objects that grow
+    void resize(Object * object, std::size_t size);
+
+    // Collect if enough has been allocated since the last collection.
+    void safepoint() { if (stats_.live >= threshold_) { collect(); } }
+    void collect();
+
+    // Bound the heap to `bytes` (0 for no bound). Running out is an error.
+    void set_limit(std::size_t bytes);
+    const Stats & stats() const { return stats_; }
+
+    // Called from `Object::trace`
+    void mark(const Value & value);
+
+private:
+    // First collection happens after this many bytes
+    static constexpr std::size_t initial_threshold = 1 << 20;
+    // Values on the root stack
+    static constexpr std::size_t stack_capacity = 1 << 20;
+
+    void track(Object * object, std::size_t size);
+    void sweep();
+
+    Object * objects_ = nullptr;
+    std::vector<Object *> gray_;
+
+    std::vector<Value> stack_;
+    std::vector<const std::vector<Value> *> stacks_;
+    std::vector<const std::unordered_map<std::string, Value> *> maps_;
+
+    std::size_t threshold_ = initial_threshold;
+    std::size_t limit_ = 0;
+    Stats stats_;
+};
+
+// The heap all Values live in.
+Heap & heap();
+
+template <typename T, typename... Args>
+Value make_object(Args &&... args) { return heap().make<T>(std::forward<Args>(args)...); }
+
+// Pops whatever was pushed on the root stack during its lifetime.
+class RootScope {
+public:
+    RootScope() : base_(heap().stack().size()) { }
+    RootScope(const RootScope &) = delete;
+    ~RootScope() { heap().stack().resize(base_); }
+
+    // Height of the root stack when the scope was entered
+    std::size_t base() const { return base_; }
+
+private:
+    std::size_t base_;
+};
+
+}
+
+}
+
+#endif
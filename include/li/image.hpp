@@ -0,0 +1,112 @@
+#ifndef H_IMAGE
+#define H_IMAGE
+
+#include "li/ast.hpp"
+#include "li/env.hpp"
+#include "li/value.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Program images: the parsed and resolved top-level forms of a source
+// file, saved so that running the same source again skips tokenizing,
+// parsing and resolution. The same image serves both engines.
+//
+// Layout:
+//
+//   magic "LISPIMG" '\0' | u32 version | u64 source hash | u64 source size
+//   u64 checksum (FNV-1a of everything after it)
+//   name count | names, each a length and its bytes
+//   form count | forms
+//
+// The header is little-endian; everything after it is a varint (LEB128,
+// zigzag for integers that can be negative). A node is its `NodeTag`
+// followed by its fields. Names are indices into the name table, lists
+// are a count and their elements.
+
+// Identifies the source an image was made from
+struct ImageKey {
+    std::uint64_t hash;
+    std::uint64_t size;
+};
+
+// Writes an image; see `ASTNode::save`.
+class ImageWriter {
+public:
+    void tag(NodeTag tag) { varint(static_cast<std::uint64_t>(tag)); }
+    void varint(std::uint64_t value);
+    void integer(std::int64_t value);
+    void name(const std::string & name);
+    void address(const Env::address & addr);
+    void node(const ASTNode & node) { node.save(*this); }
+    void nodes(const ASTNode::node_list & nodes);
+
+    // The complete image of `forms`, parsed from the source `key`
+    std::string image(const ImageKey & key, const std::vector<node_ptr> & forms);
+
+private:
+    void fixed(std::uint64_t value, int bytes);
+
+    std::string bytes_;
+    std::vector<const std::string *> names_;
+    std::unordered_map<std::string_view, std::uint64_t> indices_;
+};
+
+// Reads an image back, checking every read against its end: an image
+// that is cut short or otherwise damaged is rejected, not trusted. (The
+// lexical addresses it holds cannot be checked as they are read, so
+// `load_image` first checks the image against its checksum.)
+class ImageReader {
+public:
+    ImageReader(std::string_view bytes, const std::unordered_map<std::string, Value> * builtins)
+        : bytes_(bytes), builtins_(builtins) { }
+
+    std::string_view bytes(std::size_t count);
+    std::uint64_t fixed(int bytes);
+    std::uint64_t varint();
+    std::int64_t integer();
+    void names();
+    const std::string & name();
+    Env::address address();
+    node_ptr node();
+    ASTNode::node_list nodes();
+    bool done() const { return bytes_.empty(); }
+    // What is left to read
+    std::string_view rest() const { return bytes_; }
+
+private:
+    std::string_view bytes_;
+    std::vector<std::string> names_;
+    const std::unordered_map<std::string, Value> * builtins_;
+};
+
+// Key of the image of `source`, as optimized (see optimize.hpp) or not.
+// Images are optimized but for folding, which is redone when loaded.
+ImageKey image_key(std::string_view source, bool optimized = true);
+
+// Where the image of `key` is kept in `dir`
+std::string image_path(const std::string & dir, const ImageKey & key);
+
+// Write the image atomically, so concurrent runs never see part of
+// one. Returns false if it could not be written.
+bool save_image(const std::string & path, const ImageKey & key, const std::vector<node_ptr> & forms);
+
+// Read the image at `path` into `forms`, binding builtin references to
+// `builtins`. Returns false if there is no usable image of `key`: it is
+// missing, was made from other source, or is not a valid image.
+bool load_image(const std::string & path, const ImageKey & key,
+                const std::unordered_map<std::string, Value> * builtins,
+                std::vector<node_ptr> & forms);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef H_KERNELS
+#define H_KERNELS
+
+#include "li/value.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Bulk arithmetic on sequences of Values (vectors, and the arguments of
+// variadic builtins). Fixnums already hold their integer unboxed in the
+// upper half of the word, so these work on the Values in place, several
+// at a time with AVX2 or SSE4.1 when the CPU has them (chosen once, at
+// the first call), and one at a time otherwise.
+//
+// Each kernel handles only fixnums whose results fit. Otherwise (any
+// other value, or an overflow) it returns nullopt or false, having done
+// nothing observable, and the caller redoes the work with the generic
+// arithmetic of number.hpp.
+struct Kernels {
+    const char * name;
+    // Sums are exact for fewer than 2^32 values.
+    std::optional<std::int64_t> (*sum)(value_span values);
+    // Of a non-empty sequence
+    std::optional<int> (*min)(value_span values);
+    std::optional<int> (*max)(value_span values);
+    std::optional<std::int64_t> (*dot)(value_span a, value_span b);
+    // Element-wise into `out`, which has room for `a.size()` Values
+    bool (*add)(value_span a, value_span b, Value * out);
+    bool (*scale)(value_span a, int factor, Value * out);
+};
+
+// The fastest kernels this CPU supports
+const Kernels & kernels();
+
+// Shortest argument list for which variadic builtins use the kernels
+constexpr std::size_t kernel_min_args = 8;
+
+}
+
+}
+
+#endif
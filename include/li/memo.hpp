@@ -0,0 +1,58 @@
+#ifndef H_MEMO
+#define H_MEMO
+
+#include "li/value.hpp"
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// A procedure that remembers its results by the values of its arguments,
+// compared as hash table keys are (see hash.hpp), so each distinct call
+// runs once. With a bound on the number of results kept, the least
+// recently used one is forgotten first. Only meant for procedures whose
+// results depend on nothing but their arguments.
+class Memo : public Object {
+public:
+    // `capacity` 0 keeps every result.
+    Memo(Value procedure, std::size_t capacity);
+    Value call(value_span args) override;
+    std::string to_string() const override;
+    void trace(Heap & heap) const override;
+
+    bool is_callable() const override { return true; }
+
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+    std::size_t size() const { return index_.size(); }
+
+private:
+    struct Entry {
+        std::vector<Value> args;
+        Value result;
+    };
+    using entry_list = std::list<Entry>;
+
+    struct ArgsHash { std::size_t operator()(value_span args) const; };
+    struct ArgsEqual { bool operator()(value_span a, value_span b) const; };
+
+    Value procedure_;
+    std::size_t capacity_;
+    entry_list entries_; // most recently used first
+    // Keyed by the arguments stored in the entries
+    std::unordered_map<value_span, entry_list::iterator, ArgsHash, ArgsEqual> index_;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef H_NUMBER
+#define H_NUMBER
+
+#include "li/value.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Integers of any size. Those that fit in 32 bits are fixnums, stored in
+// the Value itself; larger ones are Bignums, on the heap. Every operation
+// returns the canonical form (a fixnum whenever the result fits), so each
+// integer has exactly one representation.
+//
+// The arithmetic below first tries two fixnums whose result does not
+// overflow, inline; anything else is done out of line on bignums.
+
+class Bignum : public Object {
+public:
+    using limb = std::uint32_t;
+
+    // `magnitude` is least significant limb first, without leading zeros.
+    Bignum(bool negative, std::vector<limb> && magnitude);
+    std::string to_string() const override;
+
+    bool is_bignum() const override { return true; }
+
+    bool negative() const { return negative_; }
+    const std::vector<limb> & magnitude() const { return magnitude_; }
+
+private:
+    const bool negative_;
+    const std::vector<limb> magnitude_;
+};
+
+// `value`, as a fixnum if it fits
+Value integer(std::int64_t value);
+Value integer(bool negative, std::vector<Bignum::limb> && magnitude);
+// An optional sign followed by decimal digits
+Value parse_integer(std::string_view text);
+// Keep `value` alive for the rest of the run, as a literal of the program
+// (like interned names, literals are never freed).
+Value pin(Value value);
+
+Value add_big(const Value & a, const Value & b);
+Value subtract_big(const Value & a, const Value & b);
+Value multiply_big(const Value & a, const Value & b);
+Value quotient_big(const Value & a, const Value & b);
+Value remainder_big(const Value & a, const Value & b);
+int compare_big(const Value & a, const Value & b);
+
+inline Value add(const Value & a, const Value & b)
+{
+    int result;
+    if (a.is_fixnum() && b.is_fixnum() && !__builtin_add_overflow(a.fixnum(), b.fixnum(), &result)) {
+        return Value::number(result);
+    }
+    return add_big(a, b);
+}
+
+inline Value subtract(const Value & a, const Value & b)
+{
+    int result;
+    if (a.is_fixnum() && b.is_fixnum() && !__builtin_sub_overflow(a.fixnum(), b.fixnum(), &result)) {
+        return Value::number(result);
+    }
+    return subtract_big(a, b);
+}
+
+inline Value multiply(const Value & a, const Value & b)
+{
+    int result;
+    if (a.is_fixnum() && b.is_fixnum() && !__builtin_mul_overflow(a.fixnum(), b.fixnum(), &result)) {
+        return Value::number(result);
+    }
+    return multiply_big(a, b);
+}
+
+// Truncated towards zero, like C++ `/` and `%`: the remainder has the sign
+// of `a`. Dividing by zero is an error.
+inline Value quotient(const Value & a, const Value & b)
+{
+    if (a.is_fixnum() && b.is_fixnum() && b.fixnum() != 0 && b.fixnum() != -1) {
+        return Value::number(a.fixnum() / b.fixnum());
+    }
+    return quotient_big(a, b);
+}
+
+inline Value remainder(const Value & a, const Value & b)
+{
+    if (a.is_fixnum() && b.is_fixnum() && b.fixnum() != 0 && b.fixnum() != -1) {
+        return Value::number(a.fixnum() % b.fixnum());
+    }
+    return remainder_big(a, b);
+}
+
+// Negative, zero or positive as `a` is less than, equal to or greater than `b`
+inline int compare(const Value & a, const Value & b)
+{
+    if (a.is_fixnum() && b.is_fixnum()) { return (a.fixnum() > b.fixnum()) - (a.fixnum() < b.fixnum()); }
+    return compare_big(a, b);
+}
+
+Value negate(const Value & a);
+// Exact, by repeated squaring. With a negative exponent the result is a
+// fraction, truncated towards zero as by `quotient`.
+Value expt(const Value & base, const Value & exponent);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef H_OPTIMIZE
+#define H_OPTIMIZE
+
+#include "li/ast.hpp"
+
+#include <optional>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Simplifies each top-level form once it has been resolved, before it is
+// run (see `ASTNode::optimize`):
+//  - pure builtins applied to literals are evaluated, and the calls
+//    replaced by FoldNodes holding their results;
+//  - `cond` clauses whose test is a literal are dropped if it is #f, and
+//    end the `cond` otherwise, so no unreachable clause is kept;
+//  - nested `begin`s, `and`s and `or`s are spliced into the outer one,
+//    and literals that cannot affect their value are removed.
+// None of this changes what a program prints or returns: a call that
+// fails is left to fail when run, and folded calls are run after all if
+// the program defines a name over a builtin (see `Env::builtin_redefined`).
+class Optimizer {
+public:
+    node_ptr optimize(const node_ptr & node) { return node->optimize(*this); }
+
+    // The result of applying `proc` to the literals `args`, if it can be
+    // known before running the program
+    std::optional<Value> fold(const VarNode & proc, value_span args) const;
+    // An `and` or `or` node, simplified
+    template <typename Node>
+    node_ptr connective(Node & connective, bool stop);
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef H_OUTPUT
+#define H_OUTPUT
+
+#include <array>
+#include <ostream>
+#include <streambuf>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Standard output, through a buffer that is only written out when it is
+// full, when the stream is flushed (by `flush-output`) and at exit, so
+// printing many small values costs few system calls. Everything the
+// interpreter prints to standard output goes through `output()`, which
+// keeps it in order.
+class OutputBuffer : public std::streambuf {
+public:
+    explicit OutputBuffer(int fd);
+    OutputBuffer(const OutputBuffer &) = delete;
+    ~OutputBuffer();
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char * text, std::streamsize count) override;
+    int sync() override;
+
+private:
+    // Write out the buffered bytes, and then `count` bytes of `text`
+    bool write_out(const char * text = nullptr, std::size_t count = 0);
+
+    int fd_;
+    std::array<char, 1 << 16> buffer_;
+};
+
+std::ostream & output();
+
+}
+
+}
+
+#endif
@@ -3,22 +3,80 @@
 
 #include "li/ast.hpp"
 
+#include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace lisp {
 
 namespace interpreter {
 
+// A token of program text. Tokens do not point into the text they were
+// read from: integers are converted, and identifiers (and the digits of
+// bignums) are interned.
+struct Token {
+    enum class Kind : std::uint8_t {
+        open,
+        close,
+        boolean,
+        integer,
+        bignum,   // An integer too large for a fixnum
+        symbol,
+    };
+
+    Token(Kind k, int v = 0, std::string_view n = {}) : kind(k), value(v), name(n) { }
+
+    Kind kind;
+    int value;              // boolean, integer
+    std::string_view name;  // symbol: lower case, see `intern`; bignum: sign and digits
+};
+
+// Program text to be read one top-level form at a time. A file is mapped
+// into memory and read in place; anything else (a pipe, stdin) is read a
+// line at a time into a reused buffer, as no token spans a line.
+class Source {
+public:
+    Source() = default;
+    explicit Source(std::istream & stream) : stream_(&stream) { }
+    // Text already in memory, which must outlive the source
+    explicit Source(std::string_view text) : text_(text) { }
+    Source(const Source &) = delete;
+    Source & operator=(const Source &) = delete;
+    ~Source();
+
+    // Returns false if `filename` cannot be opened.
+    bool open(const char * filename);
+    // Whether the whole file is mapped, and so is all in `text`
+    bool mapped() const { return map_ != nullptr; }
+
+    // Text not yet read, consumed from the front by the tokenizer.
+    std::string_view & text() { return text_; }
+    // Replace the text with the next line. Returns false at the end.
+    bool refill();
+
+private:
+    std::istream * stream_ = nullptr;
+    std::ifstream file_;
+    std::string line_;
+    void * map_ = nullptr;
+    std::size_t size_ = 0;
+    std::string_view text_;
+};
+
 class Parser {
 public:
     Parser() = default;
     ~Parser() = default;
 
-    Parser(bool);
+    // `builtins` lets the resolver bind references to builtin procedures.
+    // Unless `optimize` is false, each form is simplified once resolved
+    // (see optimize.hpp).
+    Parser(bool, const std::unordered_map<std::string, Value> * builtins = nullptr, bool optimize = true);
     
-    using token_list = std::vector<std::string>;
+    using token_list = std::vector<Token>;
 
     enum status {
         success = 0,
@@ -27,13 +85,27 @@ public:
     };
 
     void reset();
-    status tokenize(std::istream & src);
-    status parse(std::istream & src, SeqNode & dst);
+    // Tokenize `src`, consuming it from the front. With `single`, stop
+    // once a complete top-level element has been read.
+    status tokenize(std::string_view & src, bool single = false);
+    status parse(std::string_view src, SeqNode & dst);
+    // Read the next top-level form of `src` into `dst`, consuming no more
+    // input than that. `dst` is left empty once the input is exhausted.
+    status read(Source & src, SeqNode & dst);
 
 private:
+    // Parse, resolve and optimize the tokens read so far, as a single element.
+    node_ptr build() const;
+    // Classify an atom, interning it if it is an identifier.
+    Token atom(std::string_view text);
+
     std::size_t paren_ = 0;
     bool multiline_ = false;
     token_list tokens_;
+    // Lower-cased identifiers are built here, to not allocate each time.
+    std::string lower_;
+    const std::unordered_map<std::string, Value> * builtins_ = nullptr;
+    bool optimize_ = true;
 };
 
 }
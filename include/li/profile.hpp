@@ -0,0 +1,140 @@
+#ifndef H_PROFILE
+#define H_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Profiles of procedure calls, in either or both of two modes.
+//
+// Traced (`--profile`): for each named lambda and each builtin, the number
+// of calls, inclusive and exclusive wall time, and the number of objects
+// allocated while it ran (not counting its callees). A procedure's call
+// lasts until it returns a value or, in tail position, hands over to
+// another call. Inclusive time counts the outermost active call of each
+// procedure only, so recursion is not counted twice.
+//
+// Sampled (`--profile-samples`): a timer signal copies the current stack
+// of calls every interval of CPU time, and the samples are written out as
+// folded stacks (`outer;inner;innermost count`, one line per stack), the
+// input of flame graph tools. Calls only push and pop a name, so this is
+// cheap enough for long runs.
+class Profiler {
+public:
+    enum class Kind { lambda, builtin };
+
+    // Checked on every call; everything else only runs when it is set.
+    static inline bool enabled = false;
+
+    void trace();
+    // Start the timer. Returns false if it could not be set up.
+    bool sample(std::chrono::microseconds interval);
+
+    void enter(std::string_view name, Kind kind);
+    void exit();
+
+    void report(std::ostream & os) const;
+    // Stop sampling, and write the samples taken as folded stacks.
+    void write_samples(std::ostream & os);
+    // Samples lost because the buffer was full
+    std::size_t dropped() const { return dropped_; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::size_t calls = 0;
+        std::size_t active = 0;
+        clock::duration inclusive {};
+        clock::duration exclusive {};
+        std::size_t allocations = 0;
+    };
+
+    struct Frame {
+        Entry * entry;
+        clock::time_point start;
+        clock::duration children {};
+        std::size_t allocations;
+        std::size_t child_allocations = 0;
+    };
+
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+    using entry_map = std::unordered_map<std::string, Entry, NameHash, std::equal_to<>>;
+
+    // Trivial, so that the sample buffer is not touched until it is used.
+    struct Call {
+        const char * name;
+        std::uint32_t size;
+        Kind kind;
+    };
+
+    struct Sample {
+        std::size_t depth; // may be more than the calls kept
+        std::size_t first; // index of its outermost call in `sampled_`
+        std::size_t kept;
+    };
+
+    // Calls deeper than this are counted but not named.
+    static constexpr std::size_t max_depth = 1 << 12;
+    // Innermost calls kept in a sample
+    static constexpr std::size_t max_sample_depth = 256;
+    static constexpr std::size_t max_samples = 1 << 18;
+    static constexpr std::size_t max_sampled_calls = 1 << 22;
+
+    static void on_timer(int);
+    void take_sample();
+    void stop();
+    static std::string frame_name(std::string_view name, Kind kind);
+
+    bool tracing_ = false;
+    entry_map lambdas_;
+    entry_map builtins_;
+    std::vector<Frame> frames_;
+
+    // Written by the evaluator and read by the signal handler, which
+    // interrupts it on the same thread: a call is stored before the depth
+    // that covers it.
+    bool sampling_ = false;
+    Call calls_[max_depth];
+    std::atomic<std::size_t> depth_ = 0;
+    std::unique_ptr<Sample[]> samples_;
+    std::unique_ptr<Call[]> sampled_;
+    std::size_t sample_count_ = 0;
+    std::size_t sampled_count_ = 0;
+    std::size_t dropped_ = 0;
+};
+
+Profiler & profiler();
+
+// Profiles a call for as long as it is in scope.
+class ProfileScope {
+public:
+    ProfileScope(std::string_view name, Profiler::Kind kind) : active_(Profiler::enabled)
+        { if (active_) { profiler().enter(name, kind); } }
+    ProfileScope(const ProfileScope &) = delete;
+    ~ProfileScope() { if (active_) { profiler().exit(); } }
+
+private:
+    bool active_;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef H_STATS
+#define H_STATS
+
+#include "li/ast.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Counters of the interpreter's own work, to tune programs by: printed
+// on exit with `--stats`, and read from Lisp with `(runtime-stats)`.
+// Lookups, frames and call depth are counted on the hot paths of both
+// engines, so they are only kept when `enabled`; the rest always are.
+struct RuntimeStats {
+    // Set by `--stats`; checked before counting lookups, frames and depth.
+    static inline bool enabled = false;
+
+    std::array<std::size_t, node_kinds> nodes {}; // by kind, as parsed or loaded
+    std::size_t local_lookups = 0;     // of frame slots and captured variables
+    std::size_t top_level_lookups = 0; // globals found among the definitions
+    std::size_t builtin_lookups = 0;   // globals found among the builtins
+    std::size_t global_cache_misses = 0; // of those, not found where they last were
+    std::size_t frames = 0;            // procedure calls, and `let`s in the tree walker
+    std::size_t depth = 0;             // procedure calls in progress
+    std::size_t max_depth = 0;
+    std::size_t memo_hits = 0;         // calls of memoized procedures answered
+    std::size_t memo_misses = 0;       // from their caches, and not
+    double parse_us = 0;               // including loading images
+    double eval_us = 0;
+
+    void count(NodeTag kind) { ++nodes[static_cast<std::size_t>(kind)]; }
+    void reached(std::size_t calls) { if (calls > max_depth) { max_depth = calls; } }
+};
+
+inline RuntimeStats & runtime_stats()
+{
+    static RuntimeStats stats;
+    return stats;
+}
+
+// Counts a procedure call of the tree walker for as long as it is in scope.
+class CallDepth {
+public:
+    CallDepth() { if (RuntimeStats::enabled) { runtime_stats().reached(++runtime_stats().depth); } }
+    CallDepth(const CallDepth &) = delete;
+    ~CallDepth() { if (RuntimeStats::enabled) { --runtime_stats().depth; } }
+};
+
+// The counters by name, in a fixed order, with the number of objects
+// allocated and the peak resident set size (in KiB) added.
+std::vector<std::pair<std::string, std::size_t>> runtime_stats_table();
+
+}
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef H_VALUE
+#define H_VALUE
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+class Value;
+class Heap;
+struct TailCall;
+
+// Arguments of a procedure call. They live on the caller's evaluation
+// stack (or in a TailCall), and are only valid for the duration of the call.
+using value_span = std::span<const Value>;
+
+// Values that do not fit in a word: pairs, vectors, hash tables, procedures
+// and bignums.
+// Objects are owned and reclaimed by the Heap (see heap.hpp).
+class Object {
+public:
+    // Procedures the VM calls without a virtual call (see `kind`)
+    enum class Kind : std::uint8_t { other, builtin, vm_closure };
+
+    virtual ~Object() = default;
+    virtual std::string to_string() const = 0;
+
+    // Procedure types
+    virtual bool is_callable() const { return false; }
+    virtual Value call(value_span);
+    // Like `call`, but may leave a call from tail position in `tail`.
+    virtual Value call_tail(value_span args, TailCall &);
+
+    // Pair types
+    virtual bool is_pair() const { return false; }
+    virtual Value get(std::size_t) const;
+
+    // Vector types
+    virtual bool is_vector() const { return false; }
+
+    // Hash table types (see hash.hpp)
+    virtual bool is_hash_table() const { return false; }
+
+    // Integers too large for a fixnum (see number.hpp)
+    virtual bool is_bignum() const { return false; }
+
+    // Mark the Values this object refers to
+    virtual void trace(Heap &) const { }
+    // Bytes allocated by the object besides itself, counted towards the heap
+    virtual std::size_t owned_size() const { return 0; }
+
+    // Set once, by the constructor: a plain load, unlike the `is_` tests.
+    Kind kind() const { return kind_; }
+
+protected:
+    Object(Kind kind = Kind::other) : kind_(kind) { }
+
+private:
+    friend class Heap;
+    Object * next_ = nullptr; // All objects, for sweeping
+    std::size_t size_ = 0;
+    bool marked_ = false;
+    const Kind kind_;
+};
+
+// A Lisp value, as a single tagged word. Fixnums (32-bit integers),
+// booleans, () and the empty result are stored in the word itself and
+// never allocate; any other value is a pointer to an Object. Copying a
+// Value is a plain copy.
+class Value {
+public:
+    // The empty result (of `display`, `newline`, ...)
+    Value() = default;
+    explicit Value(Object * object) : bits_(reinterpret_cast<std::uintptr_t>(object)) { }
+
+    static constexpr Value number(int value)
+        { return Value((static_cast<std::uintptr_t>(static_cast<std::uint32_t>(value)) << 32) | number_tag); }
+    static Value boolean(bool value) { return Value((value ? true_bit : 0) | boolean_tag); }
+    static Value unit() { return Value(unit_tag); }
+    // Empty result that prints as `name` (of `define`); see `intern`.
+    static Value null(const std::string * name)
+        { return Value(reinterpret_cast<std::uintptr_t>(name) | null_tag); }
+    // Stands for a call left in a TailCall instead of a value.
+    static Value tail_call() { return Value(std::uintptr_t(0)); }
+
+    // Numeric types: fixnums and bignums. Arithmetic is in number.hpp.
+    bool is_numeric() const { return is_fixnum() || is_bignum(); }
+    // A fixnum; an error for any other value, including a bignum.
+    int get_numeric() const;
+    bool is_fixnum() const { return tag() == number_tag; }
+    bool is_bignum() const { return is_object() && object()->is_bignum(); }
+    // Value of a fixnum, unchecked
+    int fixnum() const { return static_cast<std::int32_t>(static_cast<std::uint32_t>(bits_ >> 32)); }
+
+    // Boolean types
+    bool is_boolean() const { return tag() == boolean_tag; }
+    bool get_boolean() const { return bits_ != boolean_tag; } // Everything but #f is #t for conditionals
+
+    // Procedure types
+    bool is_callable() const { return is_object() && object()->is_callable(); }
+    Value call(value_span args) const;
+
+    // Pair types
+    bool is_pair() const { return is_object() && object()->is_pair(); }
+    Value get(std::size_t idx) const;
+
+    // Vector types
+    bool is_vector() const { return is_object() && object()->is_vector(); }
+
+    // Hash table types
+    bool is_hash_table() const { return is_object() && object()->is_hash_table(); }
+
+    // Unit/Null types
+    bool is_unit() const { return bits_ == unit_tag; }
+    bool is_null() const { return tag() == null_tag; }
+
+    bool is_tail_call() const { return bits_ == 0; }
+
+    bool is_object() const { return tag() == object_tag && bits_ != 0; }
+    Object * object() const { return reinterpret_cast<Object *>(bits_); }
+
+    std::string to_string() const;
+    friend std::ostream& operator<<(std::ostream & os, const Value & value);
+
+private:
+    // Low three bits of the word. Objects are at least 8-byte aligned.
+    // The kernels in kernels.cpp depend on the layout of fixnums.
+    static constexpr std::uintptr_t tag_mask    = 0b111;
+    static constexpr std::uintptr_t object_tag  = 0b000;
+    static constexpr std::uintptr_t number_tag  = 0b001;
+    static constexpr std::uintptr_t boolean_tag = 0b010;
+    static constexpr std::uintptr_t unit_tag    = 0b011;
+    static constexpr std::uintptr_t null_tag    = 0b100;
+    static constexpr std::uintptr_t true_bit    = 0b1000;
+
+    explicit constexpr Value(std::uintptr_t bits) : bits_(bits) { }
+
+    std::uintptr_t tag() const { return bits_ & tag_mask; }
+
+    std::uintptr_t bits_ = null_tag;
+};
+
+static_assert(sizeof(std::uintptr_t) == 8, "integers are stored in the upper half of a 64-bit word");
+
+// Names printed by the results of `define`, and identifiers read by the
+// parser. Interned strings are never freed.
+const std::string * intern(std::string_view name);
+
+// A name as a value, such as the keys of `runtime-stats`. Each name has
+// one Symbol, made on first use and never freed, so the same name is the
+// same value (and the same hash table key).
+class Symbol : public Object {
+public:
+    Symbol(const std::string & name) : name_(name) { }
+    std::string to_string() const override { return name_; }
+
+private:
+    const std::string & name_;
+};
+
+Value symbol(std::string_view name);
+
+class Pair : public Object {
+public:
+    Pair(Value l, Value r);
+    std::string to_string() const override;
+
+    bool is_pair() const override { return true; }
+    Value get(std::size_t) const override;
+    void trace(Heap & heap) const override;
+
+private:
+    // Support special printing of lists
+    std::string to_string_internal(bool outer = true) const;
+
+    Value first_;
+    Value second_;
+};
+
+// Fixed-length array of Values, for constant-time indexing
+class Vector : public Object {
+public:
+    Vector(std::size_t length, Value fill);
+    explicit Vector(std::vector<Value> && elements);
+    std::string to_string() const override;
+
+    bool is_vector() const override { return true; }
+    void trace(Heap & heap) const override;
+    std::size_t owned_size() const override { return elements_.capacity() * sizeof(Value); }
+
+    std::size_t size() const { return elements_.size(); }
+    value_span elements() const { return elements_; }
+    Value & operator[](std::size_t idx) { return elements_[idx]; }
+    const Value & operator[](std::size_t idx) const { return elements_[idx]; }
+
+private:
+    std::vector<Value> elements_;
+};
+
+class Builtin : public Object {
+public:
+    using builtin_fxn = Value (*)(value_span);
+
+    Builtin(const std::string, builtin_fxn);
+    Value call(value_span) override;
+    // The function itself, to call without the call being profiled
+    builtin_fxn function() const { return fxn_; }
+    std::string to_string() const override;
+
+    bool is_callable() const override { return true; }
+
+private:
+    const std::string name_;
+    const builtin_fxn fxn_;
+};
+
+bool is_list(const Value & value);
+
+}
+
+}
+
+#endif
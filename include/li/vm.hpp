@@ -0,0 +1,159 @@
+#ifndef H_VM
+#define H_VM
+
+#include "li/ast.hpp"
+#include "li/env.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+class VM;
+
+enum class Op : std::uint8_t {
+    constant,       // push constants[arg]
+    local,          // push slot `arg` of the current frame
+    captured,       // push captured variable `arg` of the running closure
+    global,         // push value of top-level/builtin names[arg]
+    define,         // pop value, bind names[arg] at top level, push its result
+    set_local,      // pop value into slot `arg` of the current frame
+    pop,            // discard top of stack
+    null,           // push the empty result
+    jump,           // continue at `arg`
+    jump_if_false,  // pop; continue at `arg` if #f
+    jump_if_false_keep, // continue at `arg` if top is #f, otherwise pop
+    jump_if_true_keep,  // continue at `arg` if top is not #f, otherwise pop
+    folded,         // continue at `arg` if a builtin has been redefined
+    cons,           // pop cdr and car, push a new pair
+    closure,        // pop captured values, push closure over functions[arg]
+    call,           // call procedure below `arg` arguments
+    tail_call,      // as `call`, replacing the current frame
+    ret,            // return top of stack to the caller
+};
+
+struct Instruction {
+    Op op;
+    std::uint32_t arg;
+};
+
+// A compiled lambda body (or top-level form). Let bindings are given
+// slots in the same frame as the arguments, after the procedure itself.
+struct Function {
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<std::string> names;
+    std::vector<Value> builtins; // Builtin each name was resolved to (null if none)
+    mutable std::vector<GlobalCache> caches; // Of the references to each name
+    std::vector<std::shared_ptr<const Function>> functions;
+
+    std::size_t arity = 0;
+    std::size_t captures = 0;
+    std::size_t locals = 0;
+    bool named = false;
+
+    // Source lambda (for printing); null for top-level forms
+    std::shared_ptr<const LambdaNode> lambda;
+};
+
+// Translates resolved ASTs into Functions. Nodes emit their own code
+// through `ASTNode::compile`.
+class Compiler {
+public:
+    std::shared_ptr<const Function> compile(ASTNode & program);
+
+    // Code emission
+    std::size_t emit(Op op, std::uint32_t arg = 0);
+    std::size_t here() const;
+    void patch(std::size_t at);
+    std::uint32_t constant(Value value);
+    std::uint32_t name(const std::string & name, Value builtin = Value());
+    void load(const Env::address & addr);
+
+    // Slots for `let` frames
+    std::size_t reserve(std::size_t count);
+    void push_frame(std::size_t base);
+    void pop_frame(std::size_t base);
+
+    // Nested lambdas; capture sources must be loaded before `begin_function`.
+    void begin_function(std::shared_ptr<const LambdaNode> lambda, std::size_t arity, std::size_t captures, bool named);
+    std::uint32_t end_function();
+
+private:
+    struct State {
+        std::shared_ptr<Function> function;
+        std::vector<std::size_t> bases;
+        std::size_t next = 0;
+    };
+
+    Function & current();
+
+    std::vector<State> states_;
+};
+
+// Runtime procedure created by the VM.
+class VMClosure : public Object {
+public:
+    VMClosure(std::shared_ptr<const Function> function, VM & vm, std::vector<Value> && captured);
+    Value call(value_span args) override;
+    std::string to_string() const override;
+    void trace(Heap & heap) const override;
+
+    bool is_callable() const override { return true; }
+
+private:
+    friend class VM;
+
+    std::shared_ptr<const Function> function_;
+    VM & vm_;
+    std::vector<Value> captured_;
+};
+
+// Stack machine executing compiled Functions. Locals of every active
+// call live in one contiguous value stack, which is a root of the heap.
+// The stack never reallocates: builtins are passed spans of it.
+class VM {
+public:
+    VM(Env & env);
+    VM(const VM &) = delete;
+    ~VM();
+
+    // Compile a top-level form and run it.
+    Value run(ASTNode & program);
+    // Run a top-level form already compiled (by `Compiler::compile`).
+    Value run(const Function & script);
+    Value call(VMClosure & closure, value_span args);
+
+private:
+    struct CallFrame {
+        const Function * function;
+        std::size_t ip;
+        std::size_t base;
+        VMClosure * closure;
+    };
+
+    Value execute(std::size_t depth);
+    void enter(VMClosure & closure, std::size_t base, std::size_t argc);
+    void unwind(std::size_t depth, std::size_t sp);
+    void reserve(std::size_t count) const;
+
+    // Values on the stack
+    static constexpr std::size_t stack_capacity = 1 << 22;
+
+    Env & env_;
+    // Whether `--stats` or the profiler was on when the VM was made, so
+    // entering a frame tests a single flag when neither is.
+    const bool instrumented_;
+    std::vector<Value> stack_;
+    std::vector<CallFrame> frames_;
+};
+
+}
+
+}
+
+#endif
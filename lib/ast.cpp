@@ -1,5 +1,8 @@
 #include "li/ast.hpp"
 #include "li/env.hpp"
+#include "li/heap.hpp"
+#include "li/profile.hpp"
+#include "li/stats.hpp"
 
 #include <string>
 #include <memory>
@@ -22,60 +25,72 @@ std::ostream& operator<<(std::ostream & os, const ASTNode & node)
     return os;
 }
 
-int ASTNode::get_numeric() const
+std::string ASTNode::get_identifier() const
 {
-	throw_error("non-numeric type cannot be interpreted as an integer");
-	return 0;
+	throw_error("cannot get identifier of non-variable type");
+	return "";
 }
 
-bool ASTNode::get_boolean() const
+void ASTNode::compile(Compiler &, bool)
 {
-	return true; // Everything but #f is #t for conditionals
+	throw_error("compiler: cannot compile " + to_string());
 }
 
-node_ptr ASTNode::call(node_list &)
+void ASTNode::save(ImageWriter &) const
 {
-	throw_error("non-callable type cannot be called");
-	return nullptr;
+	throw_error("image: cannot save " + to_string());
 }
 
-node_ptr ASTNode::get(std::size_t) const
+value_span TailCall::args() const
+{
+	return size_ <= inline_args ? value_span(inline_.data(), size_) : value_span(spilled_);
+}
+void TailCall::set_args(value_span args)
 {
-	throw_error("cannot get element of non-pair type");
-	return nullptr;
+	size_ = args.size();
+	if (size_ <= inline_args) { std::copy(args.begin(), args.end(), inline_.begin()); }
+	else { spilled_.assign(args.begin(), args.end()); }
 }
 
-std::string ASTNode::get_identifier() const
+// Perform calls left in `tail` until one of them produces a value.
+// Each iteration replaces the previous call's frame, so loops written
+// as tail calls run in constant stack space. Callees copy their
+// arguments out of `tail` before they can leave another call in it.
+static Value trampoline(Value result, TailCall & tail)
 {
-	throw_error("cannot get identifier of non-variable type");
-	return "";
+	while (result.is_tail_call()) {
+		Value proc = tail.proc;
+		if (!proc.is_object()) { proc.call(tail.args()); } // Reports the error
+		result = proc.object()->call_tail(tail.args(), tail);
+	}
+	return result;
 }
 
 // Literals
 
-IntNode::IntNode(int val) : value_(val) { }
-int IntNode::get_numeric() const { return value_; }
-node_ptr IntNode::eval(Env&) { return shared_from_this(); }
-std::string IntNode::to_string() const { return std::to_string(value_); }
+IntNode::IntNode(Value val) : value_(val) { runtime_stats().count(value_.is_fixnum() ? NodeTag::integer : NodeTag::bignum); }
+Value IntNode::eval(Env&) { return value_; }
+std::string IntNode::to_string() const { return value_.to_string(); }
 
-BoolNode::BoolNode(bool val) : value_(val) { }
-bool BoolNode::get_boolean() const { return value_; }
-node_ptr BoolNode::eval(Env&) { return shared_from_this(); }
+BoolNode::BoolNode(bool val) : value_(val) { runtime_stats().count(NodeTag::boolean); }
+Value BoolNode::eval(Env&) { return Value::boolean(value_); }
 std::string BoolNode::to_string() const { return std::string(value_ ? "#t" : "#f"); }
 
-node_ptr UnitNode::eval(Env&) { return shared_from_this(); }
+UnitNode::UnitNode() { runtime_stats().count(NodeTag::unit); }
+Value UnitNode::eval(Env&) { return Value::unit(); }
 std::string UnitNode::to_string() const { return std::string("()"); }
 
-NullNode::NullNode(std::string msg) : msg_(msg) {}
-node_ptr NullNode::eval(Env & /* env */) { throw "runtime: cannot evaluate empty return type"; }
-std::string NullNode::to_string() const { return msg_; }
-
 // Sequences
 
-SeqNode::SeqNode(node_list && seq) : sequence_(std::move(seq)) { }
-node_ptr SeqNode::eval(Env & env) {
+SeqNode::SeqNode(node_list && seq) : sequence_(std::move(seq)) { runtime_stats().count(NodeTag::seq); }
+Value SeqNode::eval(Env & env)
+{
+	TailCall tail;
+	return trampoline(eval_tail(env, tail), tail);
+}
+Value SeqNode::eval_tail(Env & env, TailCall & tail) {
 	if (sequence_.size() == 0) {
-		return std::make_unique<NullNode>();
+		return Value();
 	}
 
 	auto it = sequence_.cbegin();
@@ -83,7 +98,11 @@ node_ptr SeqNode::eval(Env & env) {
 	for (; it != end; ++it) {
 		(*it)->eval(env);
 	}
-	return (*it)->eval(env);
+	return (*it)->eval_tail(env, tail);
+}
+void SeqNode::resolve(Scope & scope)
+{
+	for (auto & child : sequence_) { child->resolve(scope); }
 }
 std::string SeqNode::to_string() const
 {
@@ -99,25 +118,58 @@ std::string SeqNode::to_string() const
 
 // Bindings
 
-VarNode::VarNode(std::string id) : name_(id) { }
-node_ptr VarNode::eval(Env & env ) { return env.find(name_)->eval(env); }
+VarNode::VarNode(std::string id) : name_(id) { runtime_stats().count(NodeTag::var); }
+Value VarNode::eval(Env & env )
+{
+	Value value = local_ ? env.lookup(addr_) : env.find(name_, builtin_, cache_);
+	if (value.is_null()) { throw_error("runtime: cannot evaluate empty return type"); }
+	return value;
+}
+void VarNode::resolve(Scope & scope)
+{
+	if (auto addr = scope.lookup(name_)) { local_ = true; addr_ = *addr; }
+	else { builtin_ = scope.builtin(name_); }
+}
 std::string VarNode::get_identifier() const { return name_; }
 std::string VarNode::to_string() const { return "#<Var> " + name_; }
 
-BindNode::BindNode(std::string name, node_ptr value) : name_(name), value_(value) { }
-node_ptr BindNode::eval(Env & env ) {
-	env.insert(name_, value_->eval(env), true);
-	return std::make_unique<NullNode>(name_);
+BindNode::BindNode(std::string name, node_ptr value) : name_(name), value_(value) { runtime_stats().count(NodeTag::bind); }
+Value BindNode::eval(Env & env ) {
+	env.define(name_, value_->eval(env));
+	return Value::null(intern(name_));
 }
+void BindNode::resolve(Scope & scope) { value_->resolve(scope); }
 std::string BindNode::to_string() const { return "#<Bind> (" + name_ + ", " + value_->to_string() + ")"; }
 
-LetNode::LetNode(std::vector<Env::kv_pair> && bd, node_ptr node, bool is_star) : bindings_(std::move(bd)), body_(node), star_(is_star) { }
-node_ptr LetNode::eval(Env & env ) {
-	Env current = env; // Seed new environment
+LetNode::LetNode(std::vector<Env::kv_pair> && bd, node_ptr node, bool is_star) : bindings_(std::move(bd)), body_(node), star_(is_star) { runtime_stats().count(NodeTag::let); }
+Value LetNode::eval(Env & env)
+{
+	TailCall tail;
+	return trampoline(eval_tail(env, tail), tail);
+}
+Value LetNode::eval_tail(Env & env, TailCall & tail) {
+	RootScope roots;
+	Env current = env.push_frame(); // Links a new frame onto the enclosing one
 	for (auto const & binding : bindings_) {
-		current.insert(binding.first, binding.second->eval(star_ ? current : env), false);
+		current.bind(binding.second->eval(star_ ? current : env));
+	}
+	return body_->eval_tail(current, tail);
+}
+void LetNode::resolve(Scope & scope)
+{
+	// Mirror the frame layout built by `eval`: one slot per binding, in order.
+	// For `let*`, each binding expression can see the ones before it.
+	if (star_) { scope.push_frame(); }
+	for (auto & binding : bindings_) {
+		binding.second->resolve(scope);
+		if (star_) { scope.declare(binding.first); }
 	}
-	return body_->eval(current);
+	if (!star_) {
+		scope.push_frame();
+		for (auto const & binding : bindings_) { scope.declare(binding.first); }
+	}
+	body_->resolve(scope);
+	scope.pop_frame();
 }
 std::string LetNode::to_string() const
 {
@@ -133,14 +185,34 @@ std::string LetNode::to_string() const
 
 // Procedures
 
-ProcNode::ProcNode(node_list && seq) : nodes_(std::move(seq)) { }
-node_ptr ProcNode::eval(Env & env) {
-	node_list args;
-	node_ptr proc(nodes_.front()->eval(env));
-	std::transform(std::next(nodes_.cbegin()), nodes_.cend(), std::back_inserter(args), [&env](const auto & node){
-		return node->eval(env);
-	});
-	return proc->call(args);
+FoldNode::FoldNode(Value value, node_ptr call) : value_(value), call_(std::move(call)) { }
+Value FoldNode::eval(Env & env) { return Env::builtin_redefined() ? call_->eval(env) : value_; }
+Value FoldNode::eval_tail(Env & env, TailCall & tail)
+	{ return Env::builtin_redefined() ? call_->eval_tail(env, tail) : value_; }
+std::string FoldNode::to_string() const { return "#<Fold> (" + value_.to_string() + ", " + call_->to_string() + ")"; }
+
+ProcNode::ProcNode(node_list && seq) : nodes_(std::move(seq)) { runtime_stats().count(NodeTag::proc); }
+// The procedure and its arguments are kept on the root stack while the
+// rest are evaluated, and (for `eval`) during the call.
+Value ProcNode::eval(Env & env) {
+	RootScope roots;
+	for (auto const & node : nodes_) { heap().push(node->eval(env)); }
+	value_span values(heap().stack());
+	Value proc = values[roots.base()];
+	return proc.call(values.subspan(roots.base() + 1));
+}
+Value ProcNode::eval_tail(Env & env, TailCall & tail)
+{
+	RootScope roots;
+	for (auto const & node : nodes_) { heap().push(node->eval(env)); }
+	value_span values(heap().stack());
+	tail.proc = values[roots.base()];
+	tail.set_args(values.subspan(roots.base() + 1));
+	return Value::tail_call();
+}
+void ProcNode::resolve(Scope & scope)
+{
+	for (auto & node : nodes_) { node->resolve(scope); }
 }
 std::string ProcNode::to_string() const
 {
@@ -154,41 +226,26 @@ std::string ProcNode::to_string() const
 	return out + " ]";
 }
 
-BuiltinNode::BuiltinNode(const std::string fname, const BuiltinNode::builtin_fxn & func) : name_(fname), fxn_(func) { }
-node_ptr BuiltinNode::eval(Env&) { return shared_from_this(); }
-node_ptr BuiltinNode::call(node_list & args) { return fxn_(args); }
-std::string BuiltinNode::to_string() const { return std::string("#<Builtin>: ") + name_; }
-
-LambdaNode::LambdaNode(std::vector<std::string> && arg_list, node_ptr body, std::string name) : arg_list_(std::move(arg_list)), body_(body), name_(name) { }
-node_ptr LambdaNode::eval(Env & env)
+LambdaNode::LambdaNode(std::vector<std::string> && arg_list, node_ptr body, std::string name, bool recursive) : arg_list_(std::move(arg_list)), body_(body), name_(*intern(name)), recursive_(recursive) { runtime_stats().count(NodeTag::lambda); }
+Value LambdaNode::eval(Env & env)
 {
-	env_ = env; // Capture the environment at the time of constuction
-	return shared_from_this();
+	// Capture only the free variables of the body, by value.
+	std::vector<Value> captured;
+	captured.reserve(captures_.size());
+	for (auto const & addr : captures_) {
+		captured.push_back(env.lookup(addr));
+	}
+	return make_object<Closure>(
+		std::static_pointer_cast<const LambdaNode>(shared_from_this()), env, std::move(captured));
 }
-node_ptr LambdaNode::call(node_list & args)
+void LambdaNode::resolve(Scope & scope)
 {
-	if (args.size() != arg_list_.size()) {
-		throw_error(std::format("runtime: lambda function requires {} args; called with {}", arg_list_.size(), args.size()));
-	}
-
-	// Add arguments into environment
-	Env current = env_;
-	auto l = arg_list_.cbegin();
-	auto r = args.cbegin();
-	while (l != arg_list_.cend()) {
-		current.insert(*l, *r, false);
-		++l; ++r;
-	}
-
-	// Add function itself into the environment (to allow for recursion).
-	// We can just hand over the pointer, since this is a copy of
-	// the environment (not attached to the object itself).
-	if (!name_.empty()) {
-		current.insert(name_, shared_from_this(), false);
-	}
-
-	// Eval
-	return body_->eval(current);
+	// Frame layout: arguments in order, then the procedure itself (if named).
+	scope.push_function();
+	for (auto const & arg : arg_list_) { scope.declare(arg); }
+	if (binds_self()) { scope.declare(name_); }
+	body_->resolve(scope);
+	captures_ = scope.pop_function();
 }
 std::string LambdaNode::to_string() const {
 	std::ostringstream al;
@@ -197,50 +254,87 @@ std::string LambdaNode::to_string() const {
 	return std::format("#<Lambda>: [{}] ( ", name_) + al.str() + ") ";
 }
 
-// Check if a node can be interpreted as a valid list.
-bool is_list(node_ptr node) {
-	if (node->is_unit())  { return true;  }
-	if (!node->is_pair()) { return false; }
-	return is_list(node->get(1));
-};
-
-PairNode::PairNode(node_ptr l, node_ptr r) : first_(l), second_(r) { }
-node_ptr PairNode::eval(Env & env )
-	{ return std::make_shared<PairNode>(first_->eval(env), second_->eval(env)); }
-node_ptr PairNode::get(std::size_t idx) const { return idx == 0 ? first_ : second_; }
-std::string PairNode::to_string() const { return to_string_internal(); }
-std::string PairNode::to_string_internal(bool outer) const
-{
-	// Logic for representing pairs and lists accurately.
-	bool il = is_list(get(1));
-	std::string out = "";
-	if (!il || outer) { out += "("; }
-	out += first_->is_pair()
-	    ? std::dynamic_pointer_cast<PairNode>(first_)->to_string_internal(true)
-	    : first_->to_string();
-	if (!second_->is_unit()) {
-		out += il ? " " : " . ";
-		out += second_->is_pair()
-			? std::dynamic_pointer_cast<PairNode>(second_)->to_string_internal(false)
-			: second_->to_string();
+Closure::Closure(std::shared_ptr<const LambdaNode> lambda, const Env & env, std::vector<Value> && captured)
+	: lambda_(std::move(lambda)), captured_(std::move(captured)), env_(env.capture(captured_)) { }
+Value Closure::call(value_span args)
+{
+	TailCall tail;
+	return trampoline(call_tail(args, tail), tail);
+}
+Value Closure::call_tail(value_span args, TailCall & tail)
+{
+	auto const & arg_list = lambda_->arg_list_;
+	if (args.size() != arg_list.size()) {
+		throw_error(std::format("runtime: lambda function requires {} args; called with {}", arg_list.size(), args.size()));
 	}
-	if (!il || outer) { out += ")"; }
-	return out;
+	ProfileScope profile(lambda_->name_, Profiler::Kind::lambda);
+	CallDepth depth;
+
+	// The closure sits below its frame on the root stack, to stay alive
+	// while its body runs.
+	RootScope roots;
+	heap().push(Value(this));
+
+	// Add arguments into a new frame; captured variables are reached
+	// through the closure, so no other frame is ever looked up.
+	Env current = env_.push_frame();
+	for (auto const & arg : args) {
+		current.bind(arg);
+	}
+
+	// Add the closure itself into the frame (to allow for recursion).
+	if (lambda_->binds_self()) {
+		current.bind(Value(this));
+	}
+	heap().safepoint();
+
+	// Eval (a call in tail position is returned to the trampoline)
+	return lambda_->body_->eval_tail(current, tail);
+}
+std::string Closure::to_string() const { return lambda_->to_string(); }
+void Closure::trace(Heap & heap) const
+{
+	for (auto const & value : captured_) { heap.mark(value); }
+}
+
+PairNode::PairNode(node_ptr l, node_ptr r) : first_(l), second_(r) { runtime_stats().count(NodeTag::pair); }
+Value PairNode::eval(Env & env )
+{
+	RootScope roots;
+	heap().push(first_->eval(env));
+	Value second = second_->eval(env);
+	return make_object<Pair>(heap().stack()[roots.base()], second);
+}
+void PairNode::resolve(Scope & scope)
+{
+	first_->resolve(scope);
+	second_->resolve(scope);
 }
+std::string PairNode::to_string() const { return "#<Pair> (" + first_->to_string() + ", " + second_->to_string() + ")"; }
 
-CondNode::CondNode(node_list && p_seq, node_list && n_seq) : predicate_seq_(p_seq), node_seq_(n_seq) { assert(p_seq.size() == n_seq.size()); }
-node_ptr CondNode::eval(Env & env)
+CondNode::CondNode(node_list && p_seq, node_list && n_seq) : predicate_seq_(p_seq), node_seq_(n_seq) { assert(p_seq.size() == n_seq.size()); runtime_stats().count(NodeTag::cond); }
+Value CondNode::eval(Env & env)
+{
+	TailCall tail;
+	return trampoline(eval_tail(env, tail), tail);
+}
+Value CondNode::eval_tail(Env & env, TailCall & tail)
 {
 	auto l = predicate_seq_.cbegin();
 	auto r = node_seq_.cbegin();
 	while (l != predicate_seq_.cend()) {
-		if ((*l)->eval(env)->get_boolean()) {
-			return (*r)->eval(env);
+		if ((*l)->eval(env).get_boolean()) {
+			return (*r)->eval_tail(env, tail);
 		}
 		++l; ++r;
 	}
 
-	return std::make_unique<NullNode>();
+	return Value();
+}
+void CondNode::resolve(Scope & scope)
+{
+	for (auto & node : predicate_seq_) { node->resolve(scope); }
+	for (auto & node : node_seq_) { node->resolve(scope); }
 }
 std::string CondNode::to_string() const {
 	std::string out = "#<Cond>";
@@ -258,18 +352,27 @@ std::string CondNode::to_string() const {
 	return out;
 }
 
-AndNode::AndNode(node_list && n_seq) : nodes_(n_seq) { }
-node_ptr AndNode::eval(Env & env)
+AndNode::AndNode(node_list && n_seq) : nodes_(n_seq) { runtime_stats().count(NodeTag::and_); }
+Value AndNode::eval(Env & env)
+{
+	TailCall tail;
+	return trampoline(eval_tail(env, tail), tail);
+}
+Value AndNode::eval_tail(Env & env, TailCall & tail)
 {
-	if (nodes_.size() == 0) { return std::make_unique<BoolNode>(true); }
+	if (nodes_.size() == 0) { return Value::boolean(true); }
 	
-	node_ptr val = nullptr;
-	for (const auto & node: nodes_) {
-		val = node->eval(env);
-		if (!val->get_boolean()) { break; }
+	auto last = std::prev(nodes_.cend());
+	for (auto it = nodes_.cbegin(); it != last; ++it) {
+		Value val = (*it)->eval(env);
+		if (!val.get_boolean()) { return val; }
 	}
 
-	return val;
+	return (*last)->eval_tail(env, tail);
+}
+void AndNode::resolve(Scope & scope)
+{
+	for (auto & node : nodes_) { node->resolve(scope); }
 }
 std::string AndNode::to_string() const {
 	std::string out = "#<And>[ ";
@@ -282,15 +385,28 @@ std::string AndNode::to_string() const {
 	return out + " ]";
 }
 
-OrNode::OrNode(node_list && n_seq) : nodes_(n_seq) { }
-node_ptr OrNode::eval(Env & env)
+OrNode::OrNode(node_list && n_seq) : nodes_(n_seq) { runtime_stats().count(NodeTag::or_); }
+Value OrNode::eval(Env & env)
+{
+	TailCall tail;
+	return trampoline(eval_tail(env, tail), tail);
+}
+Value OrNode::eval_tail(Env & env, TailCall & tail)
 {
-	for (const auto & node: nodes_) {
-		node_ptr val = node->eval(env);
-		if (val->get_boolean()) { return val; }
+	if (nodes_.size() == 0) { return Value::boolean(false); }
+
+	// A false last value is returned as is, which is the same as #f.
+	auto last = std::prev(nodes_.cend());
+	for (auto it = nodes_.cbegin(); it != last; ++it) {
+		Value val = (*it)->eval(env);
+		if (val.get_boolean()) { return val; }
 	}
 
-	return std::make_unique<BoolNode>(false);;
+	return (*last)->eval_tail(env, tail);
+}
+void OrNode::resolve(Scope & scope)
+{
+	for (auto & node : nodes_) { node->resolve(scope); }
 }
 std::string OrNode::to_string() const {
 	std::string out = "#<Or>[ ";
@@ -0,0 +1,255 @@
+#include "li/vm.hpp"
+#include "li/ast.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Compiler
+
+std::shared_ptr<const Function> Compiler::compile(ASTNode & program)
+{
+	states_.clear();
+	states_.push_back({ std::make_shared<Function>(), {}, 0 });
+	program.compile(*this, false);
+	emit(Op::ret);
+	return std::move(states_.back().function);
+}
+
+Function & Compiler::current() { return *states_.back().function; }
+
+std::size_t Compiler::emit(Op op, std::uint32_t arg)
+{
+	current().code.push_back({ op, arg });
+	return current().code.size() - 1;
+}
+
+std::size_t Compiler::here() const { return states_.back().function->code.size(); }
+
+// Point the jump at `at` to the next instruction to be emitted.
+void Compiler::patch(std::size_t at) { current().code[at].arg = static_cast<std::uint32_t>(here()); }
+
+std::uint32_t Compiler::constant(Value value)
+{
+	current().constants.push_back(std::move(value));
+	return static_cast<std::uint32_t>(current().constants.size() - 1);
+}
+
+std::uint32_t Compiler::name(const std::string & id, Value builtin)
+{
+	auto & names = current().names;
+	auto & builtins = current().builtins;
+	auto it = std::find(names.cbegin(), names.cend(), id);
+	if (it != names.cend()) {
+		auto index = std::distance(names.cbegin(), it);
+		if (!builtin.is_null()) { builtins[index] = builtin; }
+		return static_cast<std::uint32_t>(index);
+	}
+	names.push_back(id);
+	builtins.push_back(builtin);
+	current().caches.emplace_back();
+	return static_cast<std::uint32_t>(names.size() - 1);
+}
+
+// Lexical addresses are relative to nested `let` frames; in compiled code
+// every frame of a procedure is laid out in the same flat block of slots.
+void Compiler::load(const Env::address & addr)
+{
+	if (addr.captured) {
+		emit(Op::captured, static_cast<std::uint32_t>(addr.slot));
+		return;
+	}
+	auto const & bases = states_.back().bases;
+	emit(Op::local, static_cast<std::uint32_t>(bases[bases.size() - 1 - addr.depth] + addr.slot));
+}
+
+std::size_t Compiler::reserve(std::size_t count)
+{
+	State & state = states_.back();
+	std::size_t base = state.next;
+	state.next += count;
+	state.function->locals = std::max(state.function->locals, state.next);
+	return base;
+}
+
+void Compiler::push_frame(std::size_t base) { states_.back().bases.push_back(base); }
+
+// Slots from `base` onward are free to be reused once the frame is left.
+void Compiler::pop_frame(std::size_t base)
+{
+	states_.back().bases.pop_back();
+	states_.back().next = base;
+}
+
+void Compiler::begin_function(std::shared_ptr<const LambdaNode> lambda, std::size_t arity, std::size_t captures, bool named)
+{
+	auto function = std::make_shared<Function>();
+	function->lambda = std::move(lambda);
+	function->arity = arity;
+	function->captures = captures;
+	function->named = named;
+	function->locals = arity + (named ? 1 : 0);
+	states_.push_back({ std::move(function), { 0 }, arity + (named ? 1 : 0) });
+}
+
+std::uint32_t Compiler::end_function()
+{
+	std::shared_ptr<Function> function = std::move(states_.back().function);
+	states_.pop_back();
+	current().functions.push_back(std::move(function));
+	return static_cast<std::uint32_t>(current().functions.size() - 1);
+}
+
+// Nodes
+
+void IntNode::compile(Compiler & compiler, bool)
+	{ compiler.emit(Op::constant, compiler.constant(value_)); }
+
+void BoolNode::compile(Compiler & compiler, bool)
+	{ compiler.emit(Op::constant, compiler.constant(Value::boolean(value_))); }
+
+void UnitNode::compile(Compiler & compiler, bool)
+	{ compiler.emit(Op::constant, compiler.constant(Value::unit())); }
+
+void SeqNode::compile(Compiler & compiler, bool tail)
+{
+	if (sequence_.empty()) {
+		compiler.emit(Op::null);
+		return;
+	}
+
+	auto it = sequence_.cbegin();
+	auto end = std::prev(sequence_.cend());
+	for (; it != end; ++it) {
+		(*it)->compile(compiler, false);
+		compiler.emit(Op::pop);
+	}
+	(*it)->compile(compiler, tail);
+}
+
+void VarNode::compile(Compiler & compiler, bool)
+{
+	if (local_) { compiler.load(addr_); }
+	else        { compiler.emit(Op::global, compiler.name(name_, builtin_)); }
+}
+
+void BindNode::compile(Compiler & compiler, bool)
+{
+	value_->compile(compiler, false);
+	compiler.emit(Op::define, compiler.name(name_));
+}
+
+void LetNode::compile(Compiler & compiler, bool tail)
+{
+	// Reserve the frame first, so `let`s nested in the binding
+	// expressions are given slots after it.
+	std::size_t base = compiler.reserve(bindings_.size());
+	if (star_) { compiler.push_frame(base); }
+	std::size_t slot = base;
+	for (auto const & binding : bindings_) {
+		binding.second->compile(compiler, false);
+		compiler.emit(Op::set_local, static_cast<std::uint32_t>(slot++));
+	}
+	if (!star_) { compiler.push_frame(base); }
+	body_->compile(compiler, tail);
+	compiler.pop_frame(base);
+}
+
+void FoldNode::compile(Compiler & compiler, bool tail)
+{
+	std::size_t unfolded = compiler.emit(Op::folded);
+	compiler.emit(Op::constant, compiler.constant(value_));
+	std::size_t exit = compiler.emit(Op::jump);
+	compiler.patch(unfolded);
+	call_->compile(compiler, tail);
+	compiler.patch(exit);
+}
+
+void ProcNode::compile(Compiler & compiler, bool tail)
+{
+	for (auto const & node : nodes_) {
+		node->compile(compiler, false);
+	}
+	compiler.emit(tail ? Op::tail_call : Op::call, static_cast<std::uint32_t>(nodes_.size() - 1));
+}
+
+void LambdaNode::compile(Compiler & compiler, bool)
+{
+	for (auto const & addr : captures_) {
+		compiler.load(addr);
+	}
+	compiler.begin_function(std::static_pointer_cast<const LambdaNode>(shared_from_this()),
+		arg_list_.size(), captures_.size(), binds_self());
+	body_->compile(compiler, true);
+	compiler.emit(Op::ret);
+	compiler.emit(Op::closure, compiler.end_function());
+}
+
+void PairNode::compile(Compiler & compiler, bool)
+{
+	first_->compile(compiler, false);
+	second_->compile(compiler, false);
+	compiler.emit(Op::cons);
+}
+
+void CondNode::compile(Compiler & compiler, bool tail)
+{
+	std::vector<std::size_t> exits;
+	auto l = predicate_seq_.cbegin();
+	auto r = node_seq_.cbegin();
+	while (l != predicate_seq_.cend()) {
+		(*l)->compile(compiler, false);
+		std::size_t next = compiler.emit(Op::jump_if_false);
+		(*r)->compile(compiler, tail);
+		exits.push_back(compiler.emit(Op::jump));
+		compiler.patch(next);
+		++l; ++r;
+	}
+	compiler.emit(Op::null);
+
+	for (auto exit : exits) { compiler.patch(exit); }
+}
+
+void AndNode::compile(Compiler & compiler, bool tail)
+{
+	if (nodes_.empty()) {
+		compiler.emit(Op::constant, compiler.constant(Value::boolean(true)));
+		return;
+	}
+
+	std::vector<std::size_t> exits;
+	auto last = std::prev(nodes_.cend());
+	for (auto it = nodes_.cbegin(); it != last; ++it) {
+		(*it)->compile(compiler, false);
+		exits.push_back(compiler.emit(Op::jump_if_false_keep));
+	}
+	(*last)->compile(compiler, tail);
+
+	for (auto exit : exits) { compiler.patch(exit); }
+}
+
+void OrNode::compile(Compiler & compiler, bool tail)
+{
+	if (nodes_.empty()) {
+		compiler.emit(Op::constant, compiler.constant(Value::boolean(false)));
+		return;
+	}
+
+	std::vector<std::size_t> exits;
+	auto last = std::prev(nodes_.cend());
+	for (auto it = nodes_.cbegin(); it != last; ++it) {
+		(*it)->compile(compiler, false);
+		exits.push_back(compiler.emit(Op::jump_if_true_keep));
+	}
+	(*last)->compile(compiler, tail);
+
+	for (auto exit : exits) { compiler.patch(exit); }
+}
+
+}
+
+}
@@ -1,5 +1,9 @@
 #include "li/env.hpp"
 #include "li/ast.hpp"
+#include "li/hash.hpp"
+#include "li/heap.hpp"
+#include "li/memo.hpp"
+#include "li/stats.hpp"
 
 #include <format>
 #include <algorithm>
@@ -10,81 +14,204 @@ namespace lisp {
 
 namespace interpreter {
 
-void enforce_arg_exact_count(const char * fname, node_list & args, std::size_t count)
+// These run on every builtin call, so error messages are only
+// formatted once a check has failed.
+
+void enforce_arg_exact_count(const char * fname, value_span args, std::size_t count)
 {
-	assert_throw(
-		fname,
-		std::format("expected exactly {} args, got {}", count, args.size()),
-		args.size() == count
-	);
+	if (args.size() == count) { return; }
+	assert_throw(fname, std::format("expected exactly {} args, got {}", count, args.size()), false);
 }
 
-void enforce_min_arg_count(const char * fname, node_list & args, std::size_t count)
+void enforce_min_arg_count(const char * fname, value_span args, std::size_t count)
 {
-	assert_throw(
-		fname,
-		std::format("expected at least {} args, got {}", count, args.size()),
-		args.size() >= count
-	);
+	if (args.size() >= count) { return; }
+	assert_throw(fname, std::format("expected at least {} args, got {}", count, args.size()), false);
 }
 
-void enforce_all_numeric(const char * fname, node_list & args)
+void enforce_all_numeric(const char * fname, value_span args)
 {
-	assert_throw(
-		fname,
-		std::format("all arguments must be numeric"),
-		std::all_of(args.cbegin(), args.cend(), [](const auto & node){
-			return node->is_numeric();
-		})
-	);
+	if (std::all_of(args.begin(), args.end(), [](const auto & value){ return value.is_numeric(); })) { return; }
+	assert_throw(fname, "all arguments must be numeric", false);
 }
 
-void enforce_all_boolean(const char * fname, node_list & args)
+void enforce_all_boolean(const char * fname, value_span args)
 {
-	assert_throw(
-		fname,
-		std::format("all arguments must be boolean"),
-		std::all_of(args.cbegin(), args.cend(), [](const auto & node){
-			return node->is_boolean();
-		})
-	);
+	if (std::all_of(args.begin(), args.end(), [](const auto & value){ return value.is_boolean(); })) { return; }
+	assert_throw(fname, "all arguments must be boolean", false);
 }
 
-void enforce_all_list(const char * fname, node_list & args)
+void enforce_all_list(const char * fname, value_span args)
 {
-	assert_throw(
-		fname,
-		std::format("argument(s) must be of type list"),
-		std::all_of(args.cbegin(), args.cend(), [](const auto & node){
-			return is_list(node);
-		})
-	);
+	if (std::all_of(args.begin(), args.end(), [](const auto & value){ return is_list(value); })) { return; }
+	assert_throw(fname, "argument(s) must be of type list", false);
 }
 
-Env::Env(std::unordered_map<std::string, node_ptr> * tl, const std::unordered_map<std::string, builtin_fxn> * bt) : toplvl_(tl), builtins_(bt) { }
-void Env::insert(const std::string name, node_ptr value, bool top) {
-	if (top) { toplvl_->insert_or_assign(name, value); }
-	else     { bindings_.insert_or_assign(name, value);}
+Vector & enforce_vector(const char * fname, const Value & value)
+{
+	assert_throw(fname, "argument must be of type vector", value.is_vector());
+	return static_cast<Vector &>(*value.object());
 }
 
-node_ptr Env::find(const std::string name)
+HashTable & enforce_hash_table(const char * fname, const Value & value)
 {
-	// Check immediate environment (`let`s)
-	if (bindings_.count(name)) { return bindings_.find(name)->second; }
+	assert_throw(fname, "argument must be of type hash table", value.is_hash_table());
+	return static_cast<HashTable &>(*value.object());
+}
 
+Memo & enforce_memo(const char * fname, const Value & value)
+{
+	auto memo = value.is_object() ? dynamic_cast<Memo *>(value.object()) : nullptr;
+	assert_throw(fname, "argument must be a memoized procedure", memo != nullptr);
+	return *memo;
+}
+
+std::size_t enforce_index(const char * fname, const Value & index, std::size_t size)
+{
+	assert_throw(fname, "index must be an integer", index.is_numeric());
+	if (index.is_fixnum() && index.fixnum() >= 0 && static_cast<std::size_t>(index.fixnum()) < size) {
+		return index.fixnum();
+	}
+	assert_throw(fname, std::format("index {} out of range for length {}", index.to_string(), size), false);
+	return 0;
+}
+
+// A new top level may be where an old one was, so no cached slot is kept.
+Env::Env(std::unordered_map<std::string, Value> * tl, const std::unordered_map<std::string, Value> * bt) : toplvl_(tl), builtins_(bt)
+	{ ++version_; }
+
+Env Env::capture(const std::vector<Value> & captured) const
+{
+	Env env;
+	env.toplvl_ = toplvl_;
+	env.builtins_ = builtins_;
+	env.captured_ = &captured;
+	return env;
+}
+
+Env Env::push_frame() const
+{
+	if (RuntimeStats::enabled) { ++runtime_stats().frames; }
+	Env env = *this;
+	env.base_ = heap().stack().size();
+	env.parent_ = this;
+	return env;
+}
+void Env::bind(Value value) { heap().push(value); }
+const Value & Env::lookup(const address & addr) const
+{
+	if (RuntimeStats::enabled) { ++runtime_stats().local_lookups; }
+	if (addr.captured) { return (*captured_)[addr.slot]; }
+
+	const Env * frame = this;
+	for (std::size_t depth = addr.depth; depth > 0; --depth) { frame = frame->parent_; }
+	return heap().stack()[frame->base_ + addr.slot];
+}
+
+void Env::define(const std::string & name, Value value)
+{
+	if (builtins_ && builtins_->contains(name)) { builtin_redefined_ = true; }
+	if (toplvl_->insert_or_assign(name, value).second) { ++version_; }
+}
+
+Value Env::find(const std::string & name) const
+{
 	// Check top level (`begin`s)
-	if (toplvl_->count(name)) { return toplvl_->find(name)->second; }
+	auto tl = toplvl_->find(name);
+	if (tl != toplvl_->end()) {
+		if (RuntimeStats::enabled) { ++runtime_stats().top_level_lookups; }
+		return tl->second;
+	}
 
 	// Check builtins
-	if (builtins_->count(name)) {
-		return std::make_unique<BuiltinNode>(name, builtins_->find(name)->second);
+	auto bt = builtins_->find(name);
+	if (bt != builtins_->end()) {
+		if (RuntimeStats::enabled) { ++runtime_stats().builtin_lookups; }
+		return bt->second;
 	}
 
 	// Report not found
 	throw_error("unbound variable: " + name);
-	return nullptr;
+	return Value();
 }
 
+const Value & Env::find(const std::string & name, const Value & builtin, GlobalCache & cache) const
+{
+	if (cache.version != version_) {
+		if (RuntimeStats::enabled) { ++runtime_stats().global_cache_misses; }
+		auto tl = toplvl_->find(name);
+		if (tl != toplvl_->end()) { cache.slot = &tl->second; cache.builtin = false; }
+		else if (!builtin.is_null()) { cache.slot = &builtin; cache.builtin = true; }
+		else {
+			auto bt = builtins_->find(name);
+			if (bt == builtins_->end()) { throw_error("unbound variable: " + name); }
+			cache.slot = &bt->second;
+			cache.builtin = true;
+		}
+		cache.version = version_;
+	}
+	if (RuntimeStats::enabled) { ++(cache.builtin ? runtime_stats().builtin_lookups : runtime_stats().top_level_lookups); }
+	return *cache.slot;
+}
+
+// The outermost entry stands for code outside of any lambda.
+Scope::Scope(const std::unordered_map<std::string, Value> * builtins) : functions_(1), builtins_(builtins) { }
+
+void Scope::push_frame() { functions_.back().frames.emplace_back(); }
+void Scope::pop_frame() { functions_.back().frames.pop_back(); }
+void Scope::declare(const std::string & name) { functions_.back().frames.back().push_back(name); }
+
+void Scope::push_function()
+{
+	functions_.emplace_back();
+	push_frame();
 }
 
-}
\ No newline at end of file
+std::vector<Env::address> Scope::pop_function()
+{
+	std::vector<Env::address> sources = std::move(functions_.back().sources);
+	functions_.pop_back();
+	return sources;
+}
+
+std::optional<Env::address> Scope::lookup(const std::string & name)
+	{ return lookup(functions_.size() - 1, name); }
+
+Value Scope::builtin(const std::string & name) const
+{
+	if (!builtins_) { return Value(); }
+	auto bt = builtins_->find(name);
+	return bt != builtins_->end() ? bt->second : Value();
+}
+
+std::optional<Env::address> Scope::lookup(std::size_t fn, const std::string & name)
+{
+	Function & function = functions_[fn];
+
+	// Innermost frame first; within a frame, later bindings shadow earlier ones.
+	for (std::size_t depth = 0; depth < function.frames.size(); ++depth) {
+		auto const & frame = function.frames[function.frames.size() - 1 - depth];
+		auto it = std::find(frame.crbegin(), frame.crend(), name);
+		if (it != frame.crend()) {
+			return Env::address{ false, depth, static_cast<std::size_t>(std::distance(it, frame.crend())) - 1 };
+		}
+	}
+
+	// Already captured from an enclosing function
+	auto it = std::find(function.captured.cbegin(), function.captured.cend(), name);
+	if (it != function.captured.cend()) {
+		return Env::address{ true, 0, static_cast<std::size_t>(std::distance(function.captured.cbegin(), it)) };
+	}
+
+	// Bound in an enclosing function: capture it (transitively) by value.
+	if (fn == 0) { return std::nullopt; }
+	auto source = lookup(fn - 1, name);
+	if (!source) { return std::nullopt; }
+	function.captured.push_back(name);
+	function.sources.push_back(*source);
+	return Env::address{ true, 0, function.captured.size() - 1 };
+}
+
+}
+
+}
@@ -0,0 +1,145 @@
+#include "li/hash.hpp"
+#include "li/heap.hpp"
+#include "li/number.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+// Finalizer of MurmurHash3: every bit of `x` affects every bit of the result.
+std::uint64_t mix(std::uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccd;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53;
+	x ^= x >> 33;
+	return x;
+}
+
+std::uint64_t hash_atom(const Value & value)
+{
+	if (value.is_bignum()) {
+		auto const & big = static_cast<const Bignum &>(*value.object());
+		std::uint64_t hash = big.negative();
+		for (auto limb : big.magnitude()) { hash = mix(hash ^ limb); }
+		return hash;
+	}
+	// Anything else is the same value only if it is the same word.
+	return mix(std::bit_cast<std::uint64_t>(value));
+}
+
+}
+
+bool equal_keys(const Value & a, const Value & b)
+{
+	// Along the list iteratively, into the elements recursively
+	Value x = a, y = b;
+	while (x.is_pair() && y.is_pair()) {
+		if (!equal_keys(x.get(0), y.get(0))) { return false; }
+		x = x.get(1);
+		y = y.get(1);
+	}
+	if (x.is_bignum() && y.is_bignum()) { return compare(x, y) == 0; }
+	return std::bit_cast<std::uint64_t>(x) == std::bit_cast<std::uint64_t>(y);
+}
+
+std::uint64_t hash_key(const Value & key)
+{
+	std::uint64_t hash = 0;
+	Value node = key;
+	for (; node.is_pair(); node = node.get(1)) { hash = mix(hash + hash_key(node.get(0))); }
+	return mix(hash ^ hash_atom(node));
+}
+
+HashTable::HashTable() : slots_(initial_capacity) { }
+
+std::string HashTable::to_string() const { return std::format("#<HashTable>: {} entries", count_); }
+
+void HashTable::trace(Heap & heap) const
+{
+	for_each([&](const Value & key, const Value & value) {
+		heap.mark(key);
+		heap.mark(value);
+	});
+}
+
+std::size_t HashTable::probe(const Value & key, std::uint64_t hash) const
+{
+	const std::size_t mask = slots_.size() - 1;
+	std::size_t free = slots_.size();
+	for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+		auto const & slot = slots_[i];
+		if (slot.hash == empty) { return free != slots_.size() ? free : i; }
+		if (slot.hash == removed) {
+			if (free == slots_.size()) { free = i; }
+		} else if (slot.hash == hash && equal_keys(slot.key, key)) {
+			return i;
+		}
+	}
+}
+
+const Value * HashTable::find(const Value & key) const
+{
+	std::uint64_t hash = std::max(hash_key(key), first_hash);
+	auto const & slot = slots_[probe(key, hash)];
+	return slot.hash == hash ? &slot.value : nullptr;
+}
+
+void HashTable::insert(const Value & key, const Value & value)
+{
+	std::uint64_t hash = std::max(hash_key(key), first_hash);
+	std::size_t i = probe(key, hash);
+	if (slots_[i].hash == hash) {
+		slots_[i].value = value;
+		return;
+	}
+	if (slots_[i].hash == empty) {
+		// Keep an empty slot to end every probe; this may move `key`'s.
+		reserve();
+		i = probe(key, hash);
+		if (slots_[i].hash == empty) { ++used_; }
+	}
+	slots_[i] = { key, value, hash };
+	++count_;
+}
+
+bool HashTable::erase(const Value & key)
+{
+	std::uint64_t hash = std::max(hash_key(key), first_hash);
+	auto & slot = slots_[probe(key, hash)];
+	if (slot.hash != hash) { return false; }
+	slot = { Value(), Value(), removed };
+	--count_;
+	return true;
+}
+
+void HashTable::reserve()
+{
+	// At most three quarters full, counting removed entries
+	if (4 * (used_ + 1) <= 3 * slots_.size()) { return; }
+
+	// Rehash, dropping the removed entries, to at most half full.
+	std::size_t capacity = initial_capacity;
+	while (2 * (count_ + 1) > capacity) { capacity *= 2; }
+	std::vector<Slot> slots(capacity);
+	std::swap(slots, slots_);
+	for (auto const & slot : slots) {
+		if (slot.hash < first_hash) { continue; }
+		std::size_t i = slot.hash & (capacity - 1);
+		while (slots_[i].hash != empty) { i = (i + 1) & (capacity - 1); }
+		slots_[i] = slot;
+	}
+	used_ = count_;
+	heap().resize(this, sizeof(*this) + owned_size());
+}
+
+}
+
+}
@@ -0,0 +1,117 @@
+#include "li/heap.hpp"
+#include "li/utility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+
+namespace lisp {
+
+namespace interpreter {
+
+Heap & heap()
+{
+	static Heap instance;
+	return instance;
+}
+
+Heap::~Heap()
+{
+	while (objects_) {
+		Object * next = objects_->next_;
+		delete objects_;
+		objects_ = next;
+	}
+}
+
+void Heap::track(Object * object, std::size_t size)
+{
+	object->size_ = size;
+	object->next_ = objects_;
+	objects_ = object;
+	stats_.allocated += size;
+	++stats_.objects;
+	stats_.live += size;
+}
+
+void Heap::resize(Object * object, std::size_t size)
+{
+	if (size > object->size_) { stats_.allocated += size - object->size_; }
+	stats_.live = stats_.live - object->size_ + size;
+	stats_.freed += object->size_ > size ? object->size_ - size : 0;
+	object->size_ = size;
+}
+
+void Heap::add_root(const std::vector<Value> * values) { stacks_.push_back(values); }
+void Heap::add_root(const std::unordered_map<std::string, Value> * values) { maps_.push_back(values); }
+void Heap::remove_root(const std::vector<Value> * values) { std::erase(stacks_, values); }
+void Heap::remove_root(const std::unordered_map<std::string, Value> * values) { std::erase(maps_, values); }
+
+void Heap::set_limit(std::size_t bytes)
+{
+	limit_ = bytes;
+	if (limit_ && threshold_ > limit_) { threshold_ = limit_; }
+}
+
+void Heap::mark(const Value & value)
+{
+	if (!value.is_object() || value.object()->marked_) { return; }
+	value.object()->marked_ = true;
+	gray_.push_back(value.object());
+}
+
+void Heap::collect()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Mark everything reachable from the roots. Children are traced from
+	// an explicit worklist, so long lists do not recurse.
+	for (auto const & value : stack_) { mark(value); }
+	for (auto const * stack : stacks_) {
+		for (auto const & value : *stack) { mark(value); }
+	}
+	for (auto const * map : maps_) {
+		for (auto const & binding : *map) { mark(binding.second); }
+	}
+	while (!gray_.empty()) {
+		Object * object = gray_.back();
+		gray_.pop_back();
+		object->trace(*this);
+	}
+
+	sweep();
+
+	std::chrono::duration<double, std::milli> pause = std::chrono::steady_clock::now() - start;
+	++stats_.collections;
+	stats_.total_pause_ms += pause.count();
+	stats_.max_pause_ms = std::max(stats_.max_pause_ms, pause.count());
+
+	// Collect again once the heap has doubled (up to the limit).
+	threshold_ = std::max(initial_threshold, 2 * stats_.live);
+	if (limit_) {
+		threshold_ = std::min(threshold_, limit_);
+		if (stats_.live > limit_) {
+			throw_error(std::format("runtime: heap exhausted ({} bytes live, limit is {})", stats_.live, limit_));
+		}
+	}
+}
+
+void Heap::sweep()
+{
+	Object ** link = &objects_;
+	while (Object * object = *link) {
+		if (object->marked_) {
+			object->marked_ = false;
+			link = &object->next_;
+		} else {
+			*link = object->next_;
+			stats_.live -= object->size_;
+			stats_.freed += object->size_;
+			delete object;
+		}
+	}
+}
+
+}
+
+}
@@ -0,0 +1,411 @@
+#include "li/image.hpp"
+#include "li/ast.hpp"
+#include "li/env.hpp"
+#include "li/number.hpp"
+#include "li/utility.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+constexpr char magic[8] = { 'L', 'I', 'S', 'P', 'I', 'M', 'G', '\0' };
+// Bump whenever the layout of an image or of a node changes.
+constexpr std::uint32_t version = 4;
+
+// FNV-1a
+std::uint64_t fnv1a(std::string_view bytes)
+{
+	std::uint64_t hash = 0xcbf29ce484222325;
+	for (unsigned char chr : bytes) { hash = (hash ^ chr) * 0x100000001b3; }
+	return hash;
+}
+
+}
+
+// ImageWriter
+
+void ImageWriter::fixed(std::uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i) { bytes_.push_back(static_cast<char>(value >> (8 * i))); }
+}
+
+void ImageWriter::varint(std::uint64_t value)
+{
+	while (value >= 0x80) {
+		bytes_.push_back(static_cast<char>(value | 0x80));
+		value >>= 7;
+	}
+	bytes_.push_back(static_cast<char>(value));
+}
+
+void ImageWriter::integer(std::int64_t value)
+	{ varint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63)); }
+
+void ImageWriter::name(const std::string & name)
+{
+	auto [it, added] = indices_.emplace(name, names_.size());
+	if (added) { names_.push_back(&name); }
+	varint(it->second);
+}
+
+void ImageWriter::address(const Env::address & addr)
+{
+	varint(addr.captured);
+	varint(addr.depth);
+	varint(addr.slot);
+}
+
+void ImageWriter::nodes(const ASTNode::node_list & nodes)
+{
+	varint(nodes.size());
+	for (auto const & child : nodes) { node(*child); }
+}
+
+std::string ImageWriter::image(const ImageKey & key, const std::vector<node_ptr> & forms)
+{
+	bytes_.clear();
+	names_.clear();
+	indices_.clear();
+
+	// The forms are written first, to collect the names they use.
+	varint(forms.size());
+	for (auto const & form : forms) { node(*form); }
+	std::string body = std::move(bytes_);
+
+	bytes_.clear();
+	varint(names_.size());
+	for (auto const * name : names_) {
+		varint(name->size());
+		bytes_ += *name;
+	}
+	bytes_ += body;
+	std::string contents = std::move(bytes_);
+
+	bytes_.assign(magic, sizeof(magic));
+	fixed(version, 4);
+	fixed(key.hash, 8);
+	fixed(key.size, 8);
+	fixed(fnv1a(contents), 8);
+	bytes_ += contents;
+	return std::move(bytes_);
+}
+
+// Nodes
+
+void IntNode::save(ImageWriter & image) const
+{
+	if (value_.is_fixnum()) {
+		image.tag(NodeTag::integer);
+		image.integer(value_.fixnum());
+		return;
+	}
+	auto const & big = static_cast<const Bignum &>(*value_.object());
+	image.tag(NodeTag::bignum);
+	image.varint(big.negative());
+	image.varint(big.magnitude().size());
+	for (auto limb : big.magnitude()) { image.varint(limb); }
+}
+
+void BoolNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::boolean);
+	image.varint(value_);
+}
+
+void UnitNode::save(ImageWriter & image) const { image.tag(NodeTag::unit); }
+
+void SeqNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::seq);
+	image.nodes(sequence_);
+}
+
+void VarNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::var);
+	image.name(name_);
+	image.varint(local_);
+	if (local_) { image.address(addr_); }
+}
+
+void BindNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::bind);
+	image.name(name_);
+	image.node(*value_);
+}
+
+void LetNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::let);
+	image.varint(star_);
+	image.varint(bindings_.size());
+	for (auto const & binding : bindings_) {
+		image.name(binding.first);
+		image.node(*binding.second);
+	}
+	image.node(*body_);
+}
+
+// Saved unfolded: images are optimized when loaded, as programs are
+// when parsed.
+void FoldNode::save(ImageWriter & image) const { call_->save(image); }
+
+void ProcNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::proc);
+	image.nodes(nodes_);
+}
+
+void LambdaNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::lambda);
+	image.name(name_);
+	image.varint(recursive_);
+	image.varint(arg_list_.size());
+	for (auto const & arg : arg_list_) { image.name(arg); }
+	image.varint(captures_.size());
+	for (auto const & addr : captures_) { image.address(addr); }
+	image.node(*body_);
+}
+
+void PairNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::pair);
+	image.node(*first_);
+	image.node(*second_);
+}
+
+void CondNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::cond);
+	image.nodes(predicate_seq_);
+	image.nodes(node_seq_);
+}
+
+void AndNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::and_);
+	image.nodes(nodes_);
+}
+
+void OrNode::save(ImageWriter & image) const
+{
+	image.tag(NodeTag::or_);
+	image.nodes(nodes_);
+}
+
+// ImageReader
+
+std::string_view ImageReader::bytes(std::size_t count)
+{
+	if (count > bytes_.size()) { throw_error("image: truncated"); }
+	std::string_view bytes = bytes_.substr(0, count);
+	bytes_.remove_prefix(count);
+	return bytes;
+}
+
+std::uint64_t ImageReader::fixed(int bytes)
+{
+	std::string_view data = this->bytes(bytes);
+	std::uint64_t value = 0;
+	for (int i = bytes - 1; i >= 0; --i) { value = (value << 8) | static_cast<unsigned char>(data[i]); }
+	return value;
+}
+
+std::uint64_t ImageReader::varint()
+{
+	std::uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		auto byte = static_cast<unsigned char>(bytes(1)[0]);
+		value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return value; }
+	}
+	throw_error("image: bad varint");
+	return 0;
+}
+
+std::int64_t ImageReader::integer()
+{
+	std::uint64_t value = varint();
+	return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void ImageReader::names()
+{
+	for (std::uint64_t count = varint(); count > 0; --count) { names_.emplace_back(bytes(varint())); }
+}
+
+const std::string & ImageReader::name()
+{
+	std::uint64_t index = varint();
+	if (index >= names_.size()) { throw_error("image: bad name"); }
+	return names_[index];
+}
+
+Env::address ImageReader::address()
+{
+	bool captured = varint() != 0;
+	std::size_t depth = varint();
+	std::size_t slot = varint();
+	return Env::address{ captured, depth, slot };
+}
+
+ASTNode::node_list ImageReader::nodes()
+{
+	ASTNode::node_list nodes;
+	for (std::uint64_t count = varint(); count > 0; --count) { nodes.push_back(node()); }
+	return nodes;
+}
+
+node_ptr ImageReader::node()
+{
+	// Fields are read into locals first, in the order they were written.
+	switch (static_cast<NodeTag>(varint())) {
+		case NodeTag::integer: return std::make_shared<IntNode>(Value::number(static_cast<int>(integer())));
+		case NodeTag::bignum: {
+			bool negative = varint() != 0;
+			std::vector<Bignum::limb> magnitude;
+			for (std::uint64_t count = varint(); count > 0; --count) {
+				magnitude.push_back(static_cast<Bignum::limb>(varint()));
+			}
+			return std::make_shared<IntNode>(pin(lisp::interpreter::integer(negative, std::move(magnitude))));
+		}
+		case NodeTag::boolean: return std::make_shared<BoolNode>(varint() != 0);
+		case NodeTag::unit:    return std::make_shared<UnitNode>();
+		case NodeTag::seq:     return std::make_shared<SeqNode>(nodes());
+		case NodeTag::var: {
+			auto var = std::make_shared<VarNode>(name());
+			var->local_ = varint() != 0;
+			if (var->local_) { var->addr_ = address(); }
+			else if (builtins_) {
+				// Builtins are looked up again, as they are objects of this run.
+				auto bt = builtins_->find(var->name_);
+				if (bt != builtins_->end()) { var->builtin_ = bt->second; }
+			}
+			return var;
+		}
+		case NodeTag::bind: {
+			std::string id = name();
+			node_ptr value = node();
+			return std::make_shared<BindNode>(id, value);
+		}
+		case NodeTag::let: {
+			bool star = varint() != 0;
+			std::vector<Env::kv_pair> bindings;
+			for (std::uint64_t count = varint(); count > 0; --count) {
+				std::string id = name();
+				bindings.emplace_back(id, node());
+			}
+			node_ptr body = node();
+			return std::make_shared<LetNode>(std::move(bindings), body, star);
+		}
+		case NodeTag::proc: return std::make_shared<ProcNode>(nodes());
+		case NodeTag::lambda: {
+			std::string id = name();
+			bool recursive = varint() != 0;
+			std::vector<std::string> arg_list;
+			for (std::uint64_t count = varint(); count > 0; --count) { arg_list.push_back(name()); }
+			std::vector<Env::address> captures;
+			for (std::uint64_t count = varint(); count > 0; --count) { captures.push_back(address()); }
+			node_ptr body = node();
+			auto lambda = std::make_shared<LambdaNode>(std::move(arg_list), body, id, recursive);
+			lambda->captures_ = std::move(captures);
+			return lambda;
+		}
+		case NodeTag::pair: {
+			node_ptr first = node();
+			node_ptr second = node();
+			return std::make_shared<PairNode>(first, second);
+		}
+		case NodeTag::cond: {
+			ASTNode::node_list pred = nodes();
+			ASTNode::node_list seq = nodes();
+			if (pred.size() != seq.size()) { throw_error("image: bad cond"); }
+			return std::make_shared<CondNode>(std::move(pred), std::move(seq));
+		}
+		case NodeTag::and_: return std::make_shared<AndNode>(nodes());
+		case NodeTag::or_:  return std::make_shared<OrNode>(nodes());
+	}
+	throw_error("image: bad node");
+	return nullptr;
+}
+
+// Images
+
+ImageKey image_key(std::string_view source, bool optimized)
+{
+	std::uint64_t hash = fnv1a(source);
+	return { optimized ? hash : ~hash, source.size() };
+}
+
+std::string image_path(const std::string & dir, const ImageKey & key)
+	{ return std::format("{}/{:016x}.lim", dir, key.hash); }
+
+bool save_image(const std::string & path, const ImageKey & key, const std::vector<node_ptr> & forms)
+{
+	std::string bytes = ImageWriter().image(key, forms);
+
+	std::error_code error;
+	std::filesystem::path target(path);
+	std::filesystem::create_directories(target.parent_path(), error);
+
+	// Written beside the image, then renamed over it.
+	std::string temporary = std::format("{}.{}.tmp", path, getpid());
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file.write(bytes.data(), bytes.size()) || !file.flush()) {
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	std::filesystem::rename(temporary, target, error);
+	if (error) { std::remove(temporary.c_str()); }
+	return !error;
+}
+
+bool load_image(const std::string & path, const ImageKey & key,
+                const std::unordered_map<std::string, Value> * builtins,
+                std::vector<node_ptr> & forms)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) { return false; }
+	std::string bytes(static_cast<std::size_t>(file.tellg()), '\0');
+	file.seekg(0);
+	if (!file.read(bytes.data(), bytes.size())) { return false; }
+
+	try {
+		ImageReader reader(bytes, builtins);
+		if (reader.bytes(sizeof(magic)) != std::string_view(magic, sizeof(magic))) { return false; }
+		if (reader.fixed(4) != version) { return false; }
+		if (reader.fixed(8) != key.hash || reader.fixed(8) != key.size) { return false; }
+		// Lexical addresses are installed as read, so the contents must be
+		// exactly as written.
+		std::uint64_t checksum = reader.fixed(8);
+		if (fnv1a(reader.rest()) != checksum) { return false; }
+		reader.names();
+
+		std::vector<node_ptr> image;
+		for (std::uint64_t count = reader.varint(); count > 0; --count) { image.push_back(reader.node()); }
+		if (!reader.done()) { return false; }
+		forms = std::move(image);
+		return true;
+	} catch (std::string const &) {
+		return false;
+	}
+}
+
+}
+
+}
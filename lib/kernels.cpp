@@ -0,0 +1,388 @@
+#include "li/kernels.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LISP_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define LISP_X86_KERNELS 0
+#endif
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+// The vector kernels read and write Values as words: a fixnum is its
+// integer in the upper half, above the tag 1.
+static_assert(sizeof(Value) == sizeof(std::uint64_t));
+static_assert(std::bit_cast<std::uint64_t>(Value::number(-2)) == 0xfffffffe00000001);
+
+namespace scalar {
+
+std::optional<std::int64_t> sum(value_span values)
+{
+	std::int64_t total = 0;
+	for (auto const & value : values) {
+		if (!value.is_fixnum()) { return std::nullopt; }
+		total += value.fixnum();
+	}
+	return total;
+}
+
+std::optional<int> min(value_span values)
+{
+	int result = INT_MAX;
+	for (auto const & value : values) {
+		if (!value.is_fixnum()) { return std::nullopt; }
+		result = std::min(result, value.fixnum());
+	}
+	return result;
+}
+
+std::optional<int> max(value_span values)
+{
+	int result = INT_MIN;
+	for (auto const & value : values) {
+		if (!value.is_fixnum()) { return std::nullopt; }
+		result = std::max(result, value.fixnum());
+	}
+	return result;
+}
+
+std::optional<std::int64_t> dot(value_span a, value_span b)
+{
+	std::int64_t total = 0;
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		if (!a[i].is_fixnum() || !b[i].is_fixnum()) { return std::nullopt; }
+		if (__builtin_add_overflow(total, std::int64_t(a[i].fixnum()) * b[i].fixnum(), &total)) { return std::nullopt; }
+	}
+	return total;
+}
+
+bool add(value_span a, value_span b, Value * out)
+{
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		int result;
+		if (!a[i].is_fixnum() || !b[i].is_fixnum() || __builtin_add_overflow(a[i].fixnum(), b[i].fixnum(), &result)) {
+			return false;
+		}
+		out[i] = Value::number(result);
+	}
+	return true;
+}
+
+bool scale(value_span a, int factor, Value * out)
+{
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		int result;
+		if (!a[i].is_fixnum() || __builtin_mul_overflow(a[i].fixnum(), factor, &result)) { return false; }
+		out[i] = Value::number(result);
+	}
+	return true;
+}
+
+constexpr Kernels kernels { "scalar", sum, min, max, dot, add, scale };
+
+}
+
+// Sums of the lanes, and of the scalar remainder
+std::optional<std::int64_t> combine(const std::int64_t * lanes, std::size_t count, std::optional<std::int64_t> rest)
+{
+	if (!rest) { return std::nullopt; }
+	std::int64_t total = *rest;
+	for (std::size_t i = 0; i < count; ++i) {
+		if (__builtin_add_overflow(total, lanes[i], &total)) { return std::nullopt; }
+	}
+	return total;
+}
+
+// The upper halves of fixnum words in `lanes`, and the scalar remainder
+std::optional<int> combine_min(const std::int64_t * lanes, std::size_t count, value_span rest)
+{
+	auto result = scalar::min(rest);
+	for (std::size_t i = 0; result && i < count; ++i) { result = std::min(*result, int(lanes[i] >> 32)); }
+	return result;
+}
+
+std::optional<int> combine_max(const std::int64_t * lanes, std::size_t count, value_span rest)
+{
+	auto result = scalar::max(rest);
+	for (std::size_t i = 0; result && i < count; ++i) { result = std::max(*result, int(lanes[i] >> 32)); }
+	return result;
+}
+
+#if LISP_X86_KERNELS
+
+// Four Values at a time. Each loop keeps a mask of lanes that have only
+// seen fixnums (or a mask of overflows), and checks it once at the end.
+namespace avx2 {
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 inline __m256i load(const Value * values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values)); }
+AVX2 inline __m256i is_fixnum(__m256i words)
+{
+	return _mm256_cmpeq_epi64(_mm256_and_si256(words, _mm256_set1_epi64x(0b111)), _mm256_set1_epi64x(1));
+}
+AVX2 inline bool all_set(__m256i mask) { return _mm256_testc_si256(mask, _mm256_set1_epi64x(-1)); }
+AVX2 inline bool any_negative(__m256i lanes) { return _mm256_movemask_pd(_mm256_castsi256_pd(lanes)); }
+// The integers of fixnum words, sign-extended to 64 bits
+AVX2 inline __m256i widen(__m256i words)
+{
+	return _mm256_blend_epi32(_mm256_srli_epi64(words, 32), _mm256_srai_epi32(words, 31), 0b10101010);
+}
+
+AVX2 std::optional<std::int64_t> sum(value_span values)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), total = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 4 <= values.size(); i += 4) {
+		__m256i words = load(&values[i]);
+		fixnums = _mm256_and_si256(fixnums, is_fixnum(words));
+		total = _mm256_add_epi64(total, widen(words));
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(32) std::int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+	return combine(lanes, 4, scalar::sum(values.subspan(i)));
+}
+
+// Fixnum words compare as their upper halves, the lower halves being equal.
+AVX2 std::optional<int> min(value_span values)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), result = _mm256_set1_epi32(INT_MAX);
+	std::size_t i = 0;
+	for (; i + 4 <= values.size(); i += 4) {
+		__m256i words = load(&values[i]);
+		fixnums = _mm256_and_si256(fixnums, is_fixnum(words));
+		result = _mm256_min_epi32(result, words);
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(32) std::int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), result);
+	return combine_min(lanes, 4, values.subspan(i));
+}
+
+AVX2 std::optional<int> max(value_span values)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), result = _mm256_set1_epi32(INT_MIN);
+	std::size_t i = 0;
+	for (; i + 4 <= values.size(); i += 4) {
+		__m256i words = load(&values[i]);
+		fixnums = _mm256_and_si256(fixnums, is_fixnum(words));
+		result = _mm256_max_epi32(result, words);
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(32) std::int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), result);
+	return combine_max(lanes, 4, values.subspan(i));
+}
+
+AVX2 std::optional<std::int64_t> dot(value_span a, value_span b)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), overflow = _mm256_setzero_si256(), total = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 4 <= a.size(); i += 4) {
+		__m256i x = load(&a[i]), y = load(&b[i]);
+		fixnums = _mm256_and_si256(fixnums, _mm256_and_si256(is_fixnum(x), is_fixnum(y)));
+		__m256i product = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32));
+		__m256i next = _mm256_add_epi64(total, product);
+		// Signed overflow: the sum's sign differs from both operands'.
+		overflow = _mm256_or_si256(overflow,
+			_mm256_and_si256(_mm256_xor_si256(total, next), _mm256_xor_si256(product, next)));
+		total = next;
+	}
+	if (!all_set(fixnums) || any_negative(overflow)) { return std::nullopt; }
+	alignas(32) std::int64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+	return combine(lanes, 4, scalar::dot(a.subspan(i), b.subspan(i)));
+}
+
+// (x << 32) + (y << 32 | 1) is the fixnum word of x + y, and overflows
+// exactly when x + y does.
+AVX2 bool add(value_span a, value_span b, Value * out)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), overflow = _mm256_setzero_si256();
+	const __m256i tag = _mm256_set1_epi64x(1);
+	std::size_t i = 0;
+	for (; i + 4 <= a.size(); i += 4) {
+		__m256i x = load(&a[i]), y = load(&b[i]);
+		fixnums = _mm256_and_si256(fixnums, _mm256_and_si256(is_fixnum(x), is_fixnum(y)));
+		x = _mm256_sub_epi64(x, tag);
+		__m256i sum = _mm256_add_epi64(x, y);
+		overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[i]), sum);
+	}
+	if (!all_set(fixnums) || any_negative(overflow)) { return false; }
+	return scalar::add(a.subspan(i), b.subspan(i), out + i);
+}
+
+AVX2 bool scale(value_span a, int factor, Value * out)
+{
+	__m256i fixnums = _mm256_set1_epi64x(-1), overflow = _mm256_setzero_si256();
+	const __m256i multiplier = _mm256_set1_epi64x(factor), bias = _mm256_set1_epi64x(std::int64_t(1) << 31);
+	std::size_t i = 0;
+	for (; i + 4 <= a.size(); i += 4) {
+		__m256i x = load(&a[i]);
+		fixnums = _mm256_and_si256(fixnums, is_fixnum(x));
+		__m256i product = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), multiplier);
+		// Fits in 32 bits when product + 2^31 is below 2^32.
+		overflow = _mm256_or_si256(overflow, _mm256_srli_epi64(_mm256_add_epi64(product, bias), 32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[i]),
+			_mm256_or_si256(_mm256_slli_epi64(product, 32), _mm256_set1_epi64x(1)));
+	}
+	if (!all_set(fixnums) || !_mm256_testz_si256(overflow, overflow)) { return false; }
+	return scalar::scale(a.subspan(i), factor, out + i);
+}
+
+#undef AVX2
+
+constexpr Kernels kernels { "avx2", sum, min, max, dot, add, scale };
+
+}
+
+// The same, two Values at a time
+namespace sse41 {
+
+#define SSE41 __attribute__((target("sse4.1")))
+
+SSE41 inline __m128i load(const Value * values) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(values)); }
+SSE41 inline __m128i is_fixnum(__m128i words)
+{
+	return _mm_cmpeq_epi64(_mm_and_si128(words, _mm_set1_epi64x(0b111)), _mm_set1_epi64x(1));
+}
+SSE41 inline bool all_set(__m128i mask) { return _mm_test_all_ones(mask); }
+SSE41 inline bool any_negative(__m128i lanes) { return _mm_movemask_pd(_mm_castsi128_pd(lanes)); }
+SSE41 inline __m128i widen(__m128i words)
+{
+	return _mm_blend_epi16(_mm_srli_epi64(words, 32), _mm_srai_epi32(words, 31), 0b11001100);
+}
+
+SSE41 std::optional<std::int64_t> sum(value_span values)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), total = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 2 <= values.size(); i += 2) {
+		__m128i words = load(&values[i]);
+		fixnums = _mm_and_si128(fixnums, is_fixnum(words));
+		total = _mm_add_epi64(total, widen(words));
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(16) std::int64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+	return combine(lanes, 2, scalar::sum(values.subspan(i)));
+}
+
+SSE41 std::optional<int> min(value_span values)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), result = _mm_set1_epi32(INT_MAX);
+	std::size_t i = 0;
+	for (; i + 2 <= values.size(); i += 2) {
+		__m128i words = load(&values[i]);
+		fixnums = _mm_and_si128(fixnums, is_fixnum(words));
+		result = _mm_min_epi32(result, words);
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(16) std::int64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), result);
+	return combine_min(lanes, 2, values.subspan(i));
+}
+
+SSE41 std::optional<int> max(value_span values)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), result = _mm_set1_epi32(INT_MIN);
+	std::size_t i = 0;
+	for (; i + 2 <= values.size(); i += 2) {
+		__m128i words = load(&values[i]);
+		fixnums = _mm_and_si128(fixnums, is_fixnum(words));
+		result = _mm_max_epi32(result, words);
+	}
+	if (!all_set(fixnums)) { return std::nullopt; }
+	alignas(16) std::int64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), result);
+	return combine_max(lanes, 2, values.subspan(i));
+}
+
+SSE41 std::optional<std::int64_t> dot(value_span a, value_span b)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), overflow = _mm_setzero_si128(), total = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 2 <= a.size(); i += 2) {
+		__m128i x = load(&a[i]), y = load(&b[i]);
+		fixnums = _mm_and_si128(fixnums, _mm_and_si128(is_fixnum(x), is_fixnum(y)));
+		__m128i product = _mm_mul_epi32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+		__m128i next = _mm_add_epi64(total, product);
+		overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(total, next), _mm_xor_si128(product, next)));
+		total = next;
+	}
+	if (!all_set(fixnums) || any_negative(overflow)) { return std::nullopt; }
+	alignas(16) std::int64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+	return combine(lanes, 2, scalar::dot(a.subspan(i), b.subspan(i)));
+}
+
+SSE41 bool add(value_span a, value_span b, Value * out)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), overflow = _mm_setzero_si128();
+	const __m128i tag = _mm_set1_epi64x(1);
+	std::size_t i = 0;
+	for (; i + 2 <= a.size(); i += 2) {
+		__m128i x = load(&a[i]), y = load(&b[i]);
+		fixnums = _mm_and_si128(fixnums, _mm_and_si128(is_fixnum(x), is_fixnum(y)));
+		x = _mm_sub_epi64(x, tag);
+		__m128i sum = _mm_add_epi64(x, y);
+		overflow = _mm_or_si128(overflow, _mm_and_si128(_mm_xor_si128(x, sum), _mm_xor_si128(y, sum)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&out[i]), sum);
+	}
+	if (!all_set(fixnums) || any_negative(overflow)) { return false; }
+	return scalar::add(a.subspan(i), b.subspan(i), out + i);
+}
+
+SSE41 bool scale(value_span a, int factor, Value * out)
+{
+	__m128i fixnums = _mm_set1_epi64x(-1), overflow = _mm_setzero_si128();
+	const __m128i multiplier = _mm_set1_epi64x(factor), bias = _mm_set1_epi64x(std::int64_t(1) << 31);
+	std::size_t i = 0;
+	for (; i + 2 <= a.size(); i += 2) {
+		__m128i x = load(&a[i]);
+		fixnums = _mm_and_si128(fixnums, is_fixnum(x));
+		__m128i product = _mm_mul_epi32(_mm_srli_epi64(x, 32), multiplier);
+		overflow = _mm_or_si128(overflow, _mm_srli_epi64(_mm_add_epi64(product, bias), 32));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&out[i]),
+			_mm_or_si128(_mm_slli_epi64(product, 32), _mm_set1_epi64x(1)));
+	}
+	if (!all_set(fixnums) || !_mm_testz_si128(overflow, overflow)) { return false; }
+	return scalar::scale(a.subspan(i), factor, out + i);
+}
+
+#undef SSE41
+
+constexpr Kernels kernels { "sse4.1", sum, min, max, dot, add, scale };
+
+}
+
+#endif
+
+}
+
+const Kernels & kernels()
+{
+	static const Kernels & instance = []() -> const Kernels & {
+#if LISP_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) { return avx2::kernels; }
+		if (__builtin_cpu_supports("sse4.1")) { return sse41::kernels; }
+#endif
+		return scalar::kernels;
+	}();
+	return instance;
+}
+
+}
+
+}
@@ -0,0 +1,81 @@
+#include "li/memo.hpp"
+#include "li/hash.hpp"
+#include "li/heap.hpp"
+#include "li/stats.hpp"
+
+#include <algorithm>
+#include <format>
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+// Rough heap footprint of an entry with `count` arguments: its list and
+// index nodes, and the arguments.
+std::size_t entry_size(std::size_t count) { return 96 + count * sizeof(Value); }
+
+}
+
+std::size_t Memo::ArgsHash::operator()(value_span args) const
+{
+	std::uint64_t hash = args.size();
+	for (auto const & arg : args) { hash = hash * 0x9e3779b97f4a7c15 + hash_key(arg); }
+	return hash;
+}
+
+bool Memo::ArgsEqual::operator()(value_span a, value_span b) const
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), equal_keys);
+}
+
+Memo::Memo(Value procedure, std::size_t capacity) : procedure_(procedure), capacity_(capacity) { }
+
+Value Memo::call(value_span args)
+{
+	// The memo and its arguments may be held only by the caller's tail
+	// call, so they go on the root stack to outlive the call below, and
+	// the arguments are used from there.
+	RootScope roots;
+	heap().push(Value(this));
+	for (auto const & arg : args) { heap().push(arg); }
+	args = value_span(heap().stack()).subspan(roots.base() + 1, args.size());
+
+	if (auto it = index_.find(args); it != index_.end()) {
+		++hits_;
+		++runtime_stats().memo_hits;
+		if (capacity_) { entries_.splice(entries_.begin(), entries_, it->second); }
+		return it->second->result;
+	}
+	++misses_;
+	++runtime_stats().memo_misses;
+
+	// Nothing is kept across the call, which may itself add entries.
+	Value result = procedure_.call(args);
+	if (index_.contains(args)) { return result; }
+
+	if (capacity_ && index_.size() == capacity_) {
+		index_.erase(entries_.back().args);
+		entries_.pop_back();
+	}
+	entries_.push_front({ std::vector<Value>(args.begin(), args.end()), result });
+	index_.emplace(entries_.front().args, entries_.begin());
+	heap().resize(this, sizeof(*this) + index_.size() * entry_size(args.size()));
+	return result;
+}
+
+std::string Memo::to_string() const { return std::format("#<Memo>: {}", procedure_.to_string()); }
+
+void Memo::trace(Heap & heap) const
+{
+	heap.mark(procedure_);
+	for (auto const & entry : entries_) {
+		for (auto const & arg : entry.args) { heap.mark(arg); }
+		heap.mark(entry.result);
+	}
+}
+
+}
+
+}
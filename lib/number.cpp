@@ -0,0 +1,391 @@
+#include "li/number.hpp"
+#include "li/heap.hpp"
+#include "li/utility.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <limits>
+#include <utility>
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+using limb = Bignum::limb;
+using digits = std::vector<limb>;
+
+constexpr std::uint64_t base = std::uint64_t(1) << 32;
+
+// An integer being worked on: sign and magnitude
+struct Integer {
+	bool negative = false;
+	digits magnitude; // least significant first, no leading zeros
+};
+
+void trim(digits & magnitude)
+{
+	while (!magnitude.empty() && magnitude.back() == 0) { magnitude.pop_back(); }
+}
+
+Integer unpack(const Value & value)
+{
+	if (value.is_fixnum()) {
+		std::int64_t fixnum = value.fixnum();
+		Integer result { fixnum < 0, {} };
+		// |INT_MIN| still fits in a limb.
+		if (fixnum != 0) { result.magnitude.push_back(static_cast<limb>(fixnum < 0 ? -fixnum : fixnum)); }
+		return result;
+	}
+	if (!value.is_bignum()) { throw_error("non-numeric type cannot be interpreted as an integer"); }
+	auto const & big = static_cast<const Bignum &>(*value.object());
+	return { big.negative(), big.magnitude() };
+}
+
+Value pack(Integer && integer)
+{
+	trim(integer.magnitude);
+	if (integer.magnitude.empty()) { return Value::number(0); }
+	if (integer.magnitude.size() == 1) {
+		std::int64_t magnitude = integer.magnitude.front();
+		std::int64_t value = integer.negative ? -magnitude : magnitude;
+		if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+			return Value::number(static_cast<int>(value));
+		}
+	}
+	return make_object<Bignum>(integer.negative, std::move(integer.magnitude));
+}
+
+// Magnitudes
+
+int compare(const digits & a, const digits & b)
+{
+	if (a.size() != b.size()) { return a.size() < b.size() ? -1 : 1; }
+	for (std::size_t i = a.size(); i-- > 0;) {
+		if (a[i] != b[i]) { return a[i] < b[i] ? -1 : 1; }
+	}
+	return 0;
+}
+
+digits add(const digits & a, const digits & b)
+{
+	const digits & longer = a.size() >= b.size() ? a : b;
+	const digits & shorter = a.size() >= b.size() ? b : a;
+	digits sum(longer.size() + 1);
+	std::uint64_t carry = 0;
+	for (std::size_t i = 0; i < longer.size(); ++i) {
+		carry += std::uint64_t(longer[i]) + (i < shorter.size() ? shorter[i] : 0);
+		sum[i] = static_cast<limb>(carry);
+		carry >>= 32;
+	}
+	sum.back() = static_cast<limb>(carry);
+	trim(sum);
+	return sum;
+}
+
+// `a` - `b`, for `a` >= `b`
+digits subtract(const digits & a, const digits & b)
+{
+	digits difference(a.size());
+	std::int64_t borrow = 0;
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		std::int64_t limb_difference = std::int64_t(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+		borrow = limb_difference < 0;
+		difference[i] = static_cast<limb>(limb_difference + (borrow ? std::int64_t(base) : 0));
+	}
+	trim(difference);
+	return difference;
+}
+
+digits multiply(const digits & a, const digits & b)
+{
+	if (a.empty() || b.empty()) { return {}; }
+	digits product(a.size() + b.size());
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		std::uint64_t carry = 0;
+		for (std::size_t j = 0; j < b.size(); ++j) {
+			carry += std::uint64_t(a[i]) * b[j] + product[i + j];
+			product[i + j] = static_cast<limb>(carry);
+			carry >>= 32;
+		}
+		product[i + b.size()] = static_cast<limb>(carry);
+	}
+	trim(product);
+	return product;
+}
+
+// Divide `a` in place by a single limb, returning the remainder.
+limb divide(digits & a, limb divisor)
+{
+	std::uint64_t rest = 0;
+	for (std::size_t i = a.size(); i-- > 0;) {
+		std::uint64_t current = (rest << 32) | a[i];
+		a[i] = static_cast<limb>(current / divisor);
+		rest = current % divisor;
+	}
+	trim(a);
+	return static_cast<limb>(rest);
+}
+
+// Knuth, The Art of Computer Programming, vol. 2, 4.3.1, Algorithm D:
+// `u` = `quotient` * `v` + `rest`, for a `v` of at least two limbs.
+void divide(const digits & u, const digits & v, digits & quotient, digits & rest)
+{
+	std::size_t m = u.size(), n = v.size();
+	if (m < n) {
+		quotient.clear();
+		rest = u;
+		return;
+	}
+
+	// Normalize, so that the top limb of the divisor has its high bit set.
+	int shift = std::countl_zero(v.back());
+	auto shifted = [shift](const digits & x, std::size_t i) {
+		limb high = x[i] << shift;
+		return shift && i > 0 ? high | (x[i - 1] >> (32 - shift)) : high;
+	};
+	digits vn(n), un(m + 1);
+	for (std::size_t i = 0; i < n; ++i) { vn[i] = shifted(v, i); }
+	for (std::size_t i = 0; i < m; ++i) { un[i] = shifted(u, i); }
+	un[m] = shift ? u[m - 1] >> (32 - shift) : 0;
+
+	quotient.assign(m - n + 1, 0);
+	for (std::size_t j = m - n + 1; j-- > 0;) {
+		// Estimate the quotient limb from the top two limbs, then correct it.
+		std::uint64_t top = (std::uint64_t(un[j + n]) << 32) | un[j + n - 1];
+		std::uint64_t qhat = top / vn[n - 1];
+		std::uint64_t rhat = top % vn[n - 1];
+		while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+			--qhat;
+			rhat += vn[n - 1];
+			if (rhat >= base) { break; }
+		}
+
+		// Multiply and subtract
+		std::int64_t borrow = 0, difference = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			std::uint64_t product = qhat * vn[i];
+			difference = std::int64_t(un[i + j]) - borrow - std::int64_t(product & 0xffffffff);
+			un[i + j] = static_cast<limb>(difference);
+			borrow = std::int64_t(product >> 32) - (difference >> 32);
+		}
+		difference = std::int64_t(un[j + n]) - borrow;
+		un[j + n] = static_cast<limb>(difference);
+
+		// Subtracted once too often: add back.
+		quotient[j] = static_cast<limb>(qhat);
+		if (difference < 0) {
+			--quotient[j];
+			std::uint64_t carry = 0;
+			for (std::size_t i = 0; i < n; ++i) {
+				carry += std::uint64_t(un[i + j]) + vn[i];
+				un[i + j] = static_cast<limb>(carry);
+				carry >>= 32;
+			}
+			un[j + n] += static_cast<limb>(carry);
+		}
+	}
+
+	// Unnormalize the remainder
+	rest.assign(n, 0);
+	for (std::size_t i = 0; i < n; ++i) {
+		rest[i] = (un[i] >> shift) | (shift ? un[i + 1] << (32 - shift) : 0);
+	}
+	trim(quotient);
+	trim(rest);
+}
+
+void divide(const Integer & a, const Integer & b, Integer * quotient, Integer * rest)
+{
+	if (b.magnitude.empty()) { throw_error("runtime: division by zero"); }
+
+	digits q, r;
+	if (b.magnitude.size() == 1) {
+		q = a.magnitude;
+		limb remainder = divide(q, b.magnitude.front());
+		if (remainder) { r.push_back(remainder); }
+	} else {
+		divide(a.magnitude, b.magnitude, q, r);
+	}
+	if (quotient) { *quotient = { a.negative != b.negative, std::move(q) }; }
+	if (rest) { *rest = { a.negative, std::move(r) }; }
+}
+
+Integer add(Integer && a, Integer && b)
+{
+	if (a.negative == b.negative) { return { a.negative, add(a.magnitude, b.magnitude) }; }
+	// Opposite signs: the larger magnitude decides the sign.
+	if (compare(a.magnitude, b.magnitude) >= 0) { return { a.negative, subtract(a.magnitude, b.magnitude) }; }
+	return { b.negative, subtract(b.magnitude, a.magnitude) };
+}
+
+}
+
+// Bignum
+
+Bignum::Bignum(bool negative, std::vector<limb> && magnitude) : negative_(negative), magnitude_(std::move(magnitude)) { }
+
+std::string Bignum::to_string() const
+{
+	// Nine decimal digits at a time, least significant first
+	constexpr limb chunk = 1000000000;
+	digits rest = magnitude_;
+	std::vector<limb> chunks;
+	while (!rest.empty()) { chunks.push_back(divide(rest, chunk)); }
+
+	std::string text = negative_ ? "-" : "";
+	text += std::to_string(chunks.back());
+	for (std::size_t i = chunks.size() - 1; i-- > 0;) { text += std::format("{:09}", chunks[i]); }
+	return text;
+}
+
+// Construction
+
+Value integer(std::int64_t value)
+{
+	if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+		return Value::number(static_cast<int>(value));
+	}
+	std::uint64_t magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+	return pack({ value < 0, { static_cast<limb>(magnitude), static_cast<limb>(magnitude >> 32) } });
+}
+
+Value integer(bool negative, std::vector<limb> && magnitude) { return pack({ negative, std::move(magnitude) }); }
+
+Value parse_integer(std::string_view text)
+{
+	bool negative = !text.empty() && text.front() == '-';
+	if (!text.empty() && (text.front() == '-' || text.front() == '+')) { text.remove_prefix(1); }
+
+	// Nine decimal digits at a time, most significant first
+	Integer result { negative, {} };
+	while (!text.empty()) {
+		std::size_t count = std::min<std::size_t>(text.size(), 9);
+		limb scale = 1, chunk = 0;
+		for (char chr : text.substr(0, count)) {
+			scale *= 10;
+			chunk = chunk * 10 + static_cast<limb>(chr - '0');
+		}
+		text.remove_prefix(count);
+
+		std::uint64_t carry = chunk;
+		for (auto & part : result.magnitude) {
+			carry += std::uint64_t(part) * scale;
+			part = static_cast<limb>(carry);
+			carry >>= 32;
+		}
+		if (carry) { result.magnitude.push_back(static_cast<limb>(carry)); }
+	}
+	return pack(std::move(result));
+}
+
+Value pin(Value value)
+{
+	static std::vector<Value> literals;
+	static bool rooted = false;
+	if (!rooted) {
+		heap().add_root(&literals);
+		rooted = true;
+	}
+	if (value.is_object()) { literals.push_back(value); }
+	return value;
+}
+
+// Arithmetic
+
+Value add_big(const Value & a, const Value & b) { return pack(add(unpack(a), unpack(b))); }
+
+Value subtract_big(const Value & a, const Value & b)
+{
+	Integer negated = unpack(b);
+	negated.negative = !negated.negative;
+	return pack(add(unpack(a), std::move(negated)));
+}
+
+Value multiply_big(const Value & a, const Value & b)
+{
+	Integer x = unpack(a), y = unpack(b);
+	return pack({ x.negative != y.negative, multiply(x.magnitude, y.magnitude) });
+}
+
+Value quotient_big(const Value & a, const Value & b)
+{
+	Integer result;
+	divide(unpack(a), unpack(b), &result, nullptr);
+	return pack(std::move(result));
+}
+
+Value remainder_big(const Value & a, const Value & b)
+{
+	Integer result;
+	divide(unpack(a), unpack(b), nullptr, &result);
+	return pack(std::move(result));
+}
+
+int compare_big(const Value & a, const Value & b)
+{
+	Integer x = unpack(a), y = unpack(b);
+	if (x.negative != y.negative) {
+		// Zero is never negative, so signs alone decide.
+		return x.negative ? -1 : 1;
+	}
+	int order = compare(x.magnitude, y.magnitude);
+	return x.negative ? -order : order;
+}
+
+Value negate(const Value & a)
+{
+	if (a.is_fixnum() && a.fixnum() != std::numeric_limits<int>::min()) { return Value::number(-a.fixnum()); }
+	Integer x = unpack(a);
+	x.negative = !x.negative;
+	return pack(std::move(x));
+}
+
+Value expt(const Value & base_value, const Value & exponent)
+{
+	Integer x = unpack(base_value), n = unpack(exponent);
+
+	// Bases whose powers are all 0, 1 or -1
+	bool unit = x.magnitude.size() == 1 && x.magnitude.front() == 1;
+	if (x.magnitude.empty() || unit) {
+		if (n.magnitude.empty()) { return Value::number(1); }
+		if (x.magnitude.empty()) {
+			if (n.negative) { throw_error("runtime: division by zero"); }
+			return Value::number(0);
+		}
+		bool odd = n.magnitude.front() & 1;
+		return Value::number(x.negative && odd ? -1 : 1);
+	}
+
+	// Otherwise a fraction truncates to 0, and anything else is too large
+	// unless the exponent is a fixnum.
+	if (n.negative) { return Value::number(0); }
+	if (!exponent.is_fixnum()) { throw_error("runtime: expt: exponent too large"); }
+	unsigned power = static_cast<unsigned>(exponent.fixnum());
+
+	// While the result fits, stay on machine integers.
+	if (base_value.is_fixnum()) {
+		std::int64_t result = 1, square = base_value.fixnum();
+		unsigned rest = power;
+		bool overflow = false;
+		while (rest && !overflow) {
+			if (rest & 1) { overflow |= __builtin_mul_overflow(result, square, &result); }
+			rest >>= 1;
+			if (rest) { overflow |= __builtin_mul_overflow(square, square, &square); }
+		}
+		if (!overflow) { return integer(result); }
+	}
+
+	digits result { 1 }, square = x.magnitude;
+	for (unsigned rest = power; rest; rest >>= 1) {
+		if (rest & 1) { result = multiply(result, square); }
+		if (rest > 1) { square = multiply(square, square); }
+	}
+	return pack({ x.negative && (power & 1), std::move(result) });
+}
+
+}
+
+}
@@ -0,0 +1,164 @@
+#include "li/optimize.hpp"
+#include "li/ast.hpp"
+#include "li/number.hpp"
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace lisp {
+
+namespace interpreter {
+
+// Optimizer
+
+// Builtins whose result depends on nothing but their arguments, and that
+// have no effects. (`expt` is left out: a small call can have a result too
+// large to be worth keeping.)
+static const std::unordered_set<std::string_view> pure_builtins = {
+	"+", "-", "*", "/", "max", "min", "=", "<", ">", "<=", ">=", "abs", "modulo", "zero?",
+	"not", "boolean?", "integer?", "pair?", "list?", "vector?", "hash-table?", "procedure?", "null?",
+};
+
+std::optional<Value> Optimizer::fold(const VarNode & proc, value_span args) const
+{
+	if (proc.builtin().is_null() || !pure_builtins.contains(proc.get_identifier())) { return std::nullopt; }
+	// Called directly, as `--profile` is only about calls the program makes.
+	auto const & builtin = dynamic_cast<const Builtin &>(*proc.builtin().object());
+	Value value;
+	try {
+		value = builtin.function()(args);
+	} catch (std::string const &) {
+		return std::nullopt; // Reported when (if ever) it is run
+	}
+	if (value.is_bignum()) { return pin(value); }
+	if (value.is_fixnum() || value.is_boolean()) { return value; }
+	return std::nullopt;
+}
+
+// Nodes
+
+node_ptr ASTNode::optimize(Optimizer &) { return shared_from_this(); }
+
+node_ptr SeqNode::optimize(Optimizer & optimizer)
+{
+	node_list flat;
+	for (auto const & child : sequence_) {
+		node_ptr node = optimizer.optimize(child);
+		auto seq = std::dynamic_pointer_cast<SeqNode>(node);
+		if (seq && !seq->sequence_.empty()) {
+			flat.splice(flat.end(), seq->sequence_);
+		} else {
+			flat.push_back(std::move(node));
+		}
+	}
+	// Only the last element gives the value, so the others are kept only
+	// for their effects, which a literal or an empty `begin` has none of.
+	for (auto it = flat.begin(); it != flat.end() && std::next(it) != flat.end();) {
+		auto seq = std::dynamic_pointer_cast<SeqNode>(*it);
+		if ((*it)->literal() || seq) { it = flat.erase(it); } else { ++it; }
+	}
+	if (flat.size() == 1) { return flat.front(); }
+	sequence_ = std::move(flat);
+	return shared_from_this();
+}
+
+node_ptr BindNode::optimize(Optimizer & optimizer)
+{
+	value_ = optimizer.optimize(value_);
+	return shared_from_this();
+}
+
+node_ptr LetNode::optimize(Optimizer & optimizer)
+{
+	for (auto & binding : bindings_) { binding.second = optimizer.optimize(binding.second); }
+	body_ = optimizer.optimize(body_);
+	return shared_from_this();
+}
+
+node_ptr ProcNode::optimize(Optimizer & optimizer)
+{
+	for (auto & node : nodes_) { node = optimizer.optimize(node); }
+	if (nodes_.empty() || !nodes_.front()->is_var()) { return shared_from_this(); }
+
+	// Arguments may be folded calls themselves.
+	std::vector<Value> args;
+	for (auto it = std::next(nodes_.cbegin()); it != nodes_.cend(); ++it) {
+		auto value = (*it)->literal();
+		if (auto folded = std::dynamic_pointer_cast<FoldNode>(*it)) { value = folded->value(); }
+		if (!value) { return shared_from_this(); }
+		args.push_back(*value);
+	}
+	auto const & proc = static_cast<const VarNode &>(*nodes_.front());
+	if (auto value = optimizer.fold(proc, args)) { return std::make_shared<FoldNode>(*value, shared_from_this()); }
+	return shared_from_this();
+}
+
+node_ptr LambdaNode::optimize(Optimizer & optimizer)
+{
+	body_ = optimizer.optimize(body_);
+	return shared_from_this();
+}
+
+node_ptr PairNode::optimize(Optimizer & optimizer)
+{
+	first_ = optimizer.optimize(first_);
+	second_ = optimizer.optimize(second_);
+	return shared_from_this();
+}
+
+node_ptr CondNode::optimize(Optimizer & optimizer)
+{
+	node_list predicates, nodes;
+	auto l = predicate_seq_.cbegin();
+	auto r = node_seq_.cbegin();
+	for (; l != predicate_seq_.cend(); ++l, ++r) {
+		node_ptr predicate = optimizer.optimize(*l);
+		auto value = predicate->literal();
+		if (value && !value->get_boolean()) { continue; } // Never taken
+		predicates.push_back(std::move(predicate));
+		nodes.push_back(optimizer.optimize(*r));
+		if (value) { break; } // Always taken, so no later clause is reached
+	}
+	if (!predicates.empty() && predicates.front()->literal()) { return nodes.front(); }
+	predicate_seq_ = std::move(predicates);
+	node_seq_ = std::move(nodes);
+	return shared_from_this();
+}
+
+// `and` and `or` are alike, but for which literal ends them (`stop`).
+template <typename Node>
+node_ptr Optimizer::connective(Node & connective, bool stop)
+{
+	node_list flat;
+	for (auto const & child : connective.nodes_) {
+		node_ptr node = optimize(child);
+		auto same = std::dynamic_pointer_cast<Node>(node);
+		if (same && !same->nodes_.empty()) {
+			flat.splice(flat.end(), same->nodes_);
+		} else {
+			flat.push_back(std::move(node));
+		}
+	}
+	// A literal that does not end it is skipped, unless it is the last,
+	// whose value is the result; one that does ends it.
+	node_list & nodes = connective.nodes_;
+	nodes.clear();
+	for (auto it = flat.begin(); it != flat.end(); ++it) {
+		auto value = (*it)->literal();
+		if (value && value->get_boolean() != stop && std::next(it) != flat.end()) { continue; }
+		nodes.push_back(*it);
+		if (value && value->get_boolean() == stop) { break; }
+	}
+	return nodes.size() == 1 ? nodes.front() : connective.shared_from_this();
+}
+
+node_ptr AndNode::optimize(Optimizer & optimizer) { return optimizer.connective(*this, false); }
+node_ptr OrNode::optimize(Optimizer & optimizer) { return optimizer.connective(*this, true); }
+
+}
+
+}
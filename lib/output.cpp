@@ -0,0 +1,82 @@
+#include "li/output.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace lisp {
+
+namespace interpreter {
+
+OutputBuffer::OutputBuffer(int fd) : fd_(fd) { setp(buffer_.data(), buffer_.data() + buffer_.size()); }
+
+OutputBuffer::~OutputBuffer() { sync(); }
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type c)
+{
+	if (!write_out()) { return traits_type::eof(); }
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+std::streamsize OutputBuffer::xsputn(const char * text, std::streamsize count)
+{
+	// Small writes are copied; one that does not fit is written out
+	// along with the buffer, without copying it.
+	if (count <= epptr() - pptr()) {
+		std::memcpy(pptr(), text, count);
+		pbump(static_cast<int>(count));
+		return count;
+	}
+	return write_out(text, count) ? count : 0;
+}
+
+int OutputBuffer::sync() { return write_out() ? 0 : -1; }
+
+bool OutputBuffer::write_out(const char * text, std::size_t count)
+{
+	iovec parts[2] = {
+		{ pbase(), static_cast<std::size_t>(pptr() - pbase()) },
+		{ const_cast<char *>(text), count },
+	};
+	setp(buffer_.data(), buffer_.data() + buffer_.size());
+	iovec * part = parts;
+	while (part != std::end(parts)) {
+		if (part->iov_len == 0) { ++part; continue; }
+		ssize_t written = writev(fd_, part, std::end(parts) - part);
+		if (written < 0) {
+			if (errno == EINTR) { continue; }
+			return false;
+		}
+		// Skip what was written, which may end partway through a part.
+		for (std::size_t left = written; left;) {
+			std::size_t skipped = std::min(left, part->iov_len);
+			part->iov_base = static_cast<char *>(part->iov_base) + skipped;
+			part->iov_len -= skipped;
+			left -= skipped;
+			if (part->iov_len == 0) { ++part; }
+		}
+	}
+	return true;
+}
+
+std::ostream & output()
+{
+	// Destroyed at exit, which writes out what is left.
+	static struct Stream {
+		OutputBuffer buffer { STDOUT_FILENO };
+		std::ostream stream { &buffer };
+	} instance;
+	return instance.stream;
+}
+
+}
+
+}
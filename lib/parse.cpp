@@ -1,371 +1,416 @@
 #include "li/parse.hpp"
+#include "li/number.hpp"
+#include "li/optimize.hpp"
+#include "li/output.hpp"
 #include "li/utility.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <vector>
 #include <cctype>
 #include <memory>
-#include <list>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace lisp {
 
 namespace interpreter {
 
-Parser::Parser(bool ml) : multiline_(ml) { }
+Parser::Parser(bool ml, const std::unordered_map<std::string, Value> * builtins, bool optimize)
+    : multiline_(ml), builtins_(builtins), optimize_(optimize) { }
 
 void Parser::reset() { paren_ = 0; tokens_.clear(); }
 
 void report_error(const char * text)
-    { std::cout << "error: " << text << std::endl; }
+    { output() << "error: " << text << '\n'; }
 
-Parser::status
-Parser::tokenize(std::istream & src)
+Source::~Source()
+{
+    if (map_) { munmap(map_, size_); }
+}
+
+bool Source::open(const char * filename)
 {
-    std::string token = "";
-
-    // If the token buffer contains a token, push it.
-    auto try_push = [this, &token](){
-        if (!token.empty()) {
-            // Convert to lower case
-            std::transform(token.begin(), token.end(), token.begin(), [](unsigned char chr){
-                return std::tolower(chr);
-            });
-            tokens_.push_back(token);
-            token.erase();
+    stream_ = nullptr;
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat info {};
+    bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+    if (regular && info.st_size > 0) {
+        void * map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            map_ = map;
+            size_ = info.st_size;
+            madvise(map_, size_, MADV_SEQUENTIAL);
+            text_ = std::string_view(static_cast<const char *>(map_), size_);
         }
-    };
+    }
+    close(fd);
+    if (map_ || (regular && info.st_size == 0)) { return true; }
+
+    // Not something that can be mapped; read it as a stream instead.
+    file_.open(filename);
+    stream_ = &file_;
+    return file_.is_open();
+}
+
+bool Source::refill()
+{
+    if (!stream_ || !std::getline(*stream_, line_)) {
+        text_ = std::string_view();
+        return false;
+    }
+    text_ = line_;
+    return true;
+}
+
+bool is_delimiter(char c)
+    { return std::isspace(static_cast<unsigned char>(c)) || c == ';' || c == '(' || c == ')'; }
 
-    // Parse tokens, one character at a
-    // time from the input stream.
+Parser::status
+Parser::tokenize(std::string_view & src, bool single)
+{
+    // Whether the last token pushed completed a top-level element
+    bool complete = false;
+    std::size_t pos = 0;
 
-    char c;
+    // Scan the text in place. An atom runs up to the next
+    // delimiter or the end of the text, and is only copied
+    // (into the symbol table) if it is a new identifier.
 
-    while (src.good()) {
-        switch (c = src.get()) {
+    while (!(single && complete) && pos < src.size()) {
+        char c = src[pos++];
+        switch (c) {
             case ';': // Comment
-                try_push();
-                while (src.good() && (src.get() != '\n'));
+                pos = std::min(src.find('\n', pos), src.size());
                 break;
             case '(': // Open paren
-                try_push();
-                tokens_.push_back("(");
+                tokens_.emplace_back(Token::Kind::open);
                 ++paren_;
                 break;
             case ')': // Close paren
-                try_push();
                 if (paren_ <= 0) {
+                    src.remove_prefix(pos);
                     report_error("tokenizer: unable to match `)` to any previous `(`");
                     return status::failure;
                 }
-                tokens_.push_back(")");
+                tokens_.emplace_back(Token::Kind::close);
                 --paren_;
+                complete = (paren_ == 0);
                 break;
-            default: // Either part of a token or a space
-                if (std::isspace(c)) { try_push(); }
-                else if (c != EOF) { token += c; }
+            default: // Either the start of an atom or a space
+                if (std::isspace(static_cast<unsigned char>(c))) { break; }
+                std::size_t first = pos - 1;
+                while (pos < src.size() && !is_delimiter(src[pos])) { ++pos; }
+                tokens_.push_back(atom(src.substr(first, pos - first)));
+                complete = (paren_ == 0);
         }
     }
 
-    try_push();
+    src.remove_prefix(pos);
 
     // We either now have a complete or an incomplete
     // s-expression stored in the token list.
     return (paren_ ==  0) ?  status::success : status::incomplete;
 }
 
-// Find matching `)` given iterator to initial `(`.
-// If not initial `(`, return begin + 1.
-// If not found, exception is thrown.
-std::vector<std::string>::const_iterator
-find_match(const std::vector<std::string>::const_iterator & begin,
-           const std::vector<std::string>::const_iterator & end)
+Token Parser::atom(std::string_view text)
 {
-    if (*begin != "(") { return begin + 1; };
-
-    std::size_t paren = 1;
-    auto it = begin + 1;
-    
-    for (; it != end; ++it) {
-        if      (*it == "(") { ++paren; }
-        else if (*it == ")") { --paren; }
-        if (paren == 0) { break; }
+    // bool
+    if (text == "#t" || text == "#T") { return { Token::Kind::boolean, true };  }
+    if (text == "#f" || text == "#F") { return { Token::Kind::boolean, false }; }
+
+    // integer: an optional sign, then digits. As with `std::stoi`,
+    // anything after the digits is ignored.
+    std::size_t sign = (text[0] == '+' || text[0] == '-') ? 1 : 0;
+    if (sign < text.size() && std::isdigit(static_cast<unsigned char>(text[sign]))) {
+        int value = 0;
+        // `std::from_chars` takes a `-`, but not a `+`.
+        auto result = std::from_chars(text.data() + (text[0] == '+'), text.data() + text.size(), value);
+        if (result.ec == std::errc::result_out_of_range) {
+            std::size_t end = text.find_first_not_of("0123456789", sign);
+            return { Token::Kind::bignum, 0, *intern(text.substr(0, end)) };
+        }
+        return { Token::Kind::integer, value };
     }
 
-    if (paren != 0) {
-        throw_error("parser: could not match `(` during immediate parsing ");
+    // identifier, in lower case
+    auto upper = std::find_if(text.begin(), text.end(), [](unsigned char chr){ return std::isupper(chr); });
+    if (upper != text.end()) {
+        lower_.assign(text);
+        std::transform(lower_.begin(), lower_.end(), lower_.begin(), [](unsigned char chr){
+            return std::tolower(chr);
+        });
+        text = lower_;
     }
-
-    return it;
+    return { Token::Kind::symbol, 0, *intern(text) };
 }
 
-// Get iterators to each element of sequence, at a given level of the tree.
-// This is needed because our sequence of tokens is linear (not nested),
-// even though it represents a tree conceptually, and will be parsed into one.
-// Note that each adjacent pair denotes an element's begin and end iterators.
-std::vector<std::vector<std::string>::const_iterator>
-split_level(const std::vector<std::string>::const_iterator & begin,
-            const std::vector<std::string>::const_iterator & end)
+// Recursive-descent parser over a range of tokens. Each token is looked
+// at once, and each node is built as soon as its elements have been read.
+class Reader {
+public:
+    using iterator = Parser::token_list::const_iterator;
+
+    Reader(iterator begin, iterator end) : it_(begin), end_(end) { }
+
+    // An atom, or a parenthesized form
+    std::unique_ptr<ASTNode> element();
+    bool done() const { return it_ == end_; }
+
+private:
+    const Token & peek() const;
+    const Token & next() { const Token & token = peek(); ++it_; return token; }
+    bool at(Token::Kind kind) const { return peek().kind == kind; }
+    bool at(std::string_view keyword) const
+        { return peek().kind == Token::Kind::symbol && peek().name == keyword; }
+    // Consume the `(` opening a list that is not an expression.
+    void open();
+
+    // Forms, once their opening `(` has been consumed
+    std::unique_ptr<ASTNode> form();
+    std::unique_ptr<ASTNode> atom(const Token & token);
+    // An identifier being bound, or `error` if the token is not one
+    std::string identifier(const char * error);
+    // Elements up to and including the closing `)`
+    ASTNode::node_list elements();
+    // Argument names up to and including the closing `)`
+    std::vector<std::string> arguments();
+
+    std::unique_ptr<ASTNode> parse_cond();
+    std::unique_ptr<ASTNode> parse_define();
+    std::unique_ptr<ASTNode> parse_define_memo();
+    std::unique_ptr<ASTNode> parse_let(bool star);
+    std::unique_ptr<ASTNode> parse_lambda();
+
+    iterator it_;
+    iterator end_;
+};
+
+const Token & Reader::peek() const
 {
-    std::vector<std::vector<std::string>::const_iterator> indices;
-
-    if ((*begin != "(") || (*(end - 1) != ")")) {
-        throw_error("parser: could not parse s-expression");
-    }
+    if (it_ == end_) { throw_error("parser: could not match `(` during immediate parsing "); }
+    return *it_;
+}
 
-    // Scan for beginnings of elements
-    if (begin + 1 != end - 1) {
-        auto it = begin + 1;
-        while (*it != ")") {
-            indices.push_back(it);
-            if (*it == "(") {
-                auto next = find_match(it, end) + 1;
-                it = next;
-            } else {
-                ++it;
-            }
-        }
-    }
+void Reader::open()
+{
+    if (!at(Token::Kind::open)) { throw_error("parser: could not parse s-expression"); }
+    ++it_;
+}
 
-    // One-past-the-end of last element (if any)
-    indices.push_back(end - 1);
+std::unique_ptr<ASTNode> Reader::element()
+{
+    const Token & token = next();
+    if (token.kind == Token::Kind::open) { return form(); }
+    if (token.kind == Token::Kind::close) { throw_error("parser: invalid s-expression"); }
+    return atom(token);
+}
 
-    return indices;
+ASTNode::node_list Reader::elements()
+{
+    ASTNode::node_list nodes;
+    while (!at(Token::Kind::close)) { nodes.emplace_back(element()); }
+    ++it_;
+    return nodes;
 }
 
-bool is_bool(std::string const & s) { return (s == "#t") || (s == "#f"); }
-bool is_int(std::string const & s)
+std::vector<std::string> Reader::arguments()
 {
-    // Not ideal, but ensures the parsing is consistent.
-    try { std::stoi(s); return true; }
-    catch (std::invalid_argument const &) { return false; }
-    catch (std::out_of_range const &) { return true; }
+    // Disallow nesting and non-identifiers
+    std::vector<std::string> arg_list;
+    while (!at(Token::Kind::close)) { arg_list.push_back(identifier("lambda: illegal argument list")); }
+    ++it_;
+    return arg_list;
 }
-bool is_identifier(std::string const & s) { return !is_bool(s) && !is_int(s); }
 
-// Nest vector elements into a lisp list.
-std::unique_ptr<ASTNode>
-construct_list(std::list<std::unique_ptr<ASTNode>> & lst)
+std::unique_ptr<ASTNode> Reader::atom(const Token & token)
 {
-    // Base case
-    if (lst.size() == 0) { return std::make_unique<UnitNode>(); }
-
-    node_ptr elem = std::move(lst.front()); 
-    lst.pop_front();
-    
-    // Nest
-    return std::make_unique<PairNode>(
-        std::move(elem),
-        construct_list(lst)
-    );
+    if (token.kind == Token::Kind::boolean)  { return std::make_unique<BoolNode>(token.value != 0); }
+    if (token.kind == Token::Kind::integer)  { return std::make_unique<IntNode>(Value::number(token.value)); }
+    if (token.kind == Token::Kind::bignum)   { return std::make_unique<IntNode>(pin(parse_integer(token.name))); }
+
+    // identifier
+    return std::make_unique<VarNode>(std::string(token.name));
 }
 
-// Main element of parser. Parses ranges of from token list into nodes.
-std::unique_ptr<ASTNode>
-parse_immediate(const std::vector<std::string>::const_iterator & begin,
-                const std::vector<std::string>::const_iterator & end)
+std::string Reader::identifier(const char * error)
 {
-    if (begin == end) { throw_error("parser: nothing to parse"); }
+    const Token & token = next();
+    if (token.kind != Token::Kind::symbol) { throw_error(error); }
+    return std::string(token.name);
+}
 
-    if (*begin == "(") {
-        // s-expression
+// Nodes for forms whose elements are all expressions. These are kept
+// out of `Reader::form`, which is on the stack once per nesting level.
 
-        if (*(end - 1) != ")")
-            { throw_error("parser: encountered malformed s-expression"); }
+std::unique_ptr<ASTNode> make_cons(ASTNode::node_list && nodes)
+{
+    if (nodes.size() != 2) { throw_error("cons: illegal syntax"); }
+    return std::make_unique<PairNode>(nodes.front(), nodes.back());
+}
 
-        // Unit
-        if (begin + 1 == end - 1) { return std::make_unique<UnitNode>(); }
+// Nest the elements into a lisp list, from the back.
+std::unique_ptr<ASTNode> make_list(ASTNode::node_list && nodes)
+{
+    std::unique_ptr<ASTNode> list = std::make_unique<UnitNode>();
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+        list = std::make_unique<PairNode>(*it, std::move(list));
+    }
+    return list;
+}
 
-        // Split into individual elements
-        auto level = split_level(begin, end);
+std::unique_ptr<ASTNode> make_if(ASTNode::node_list && nodes)
+{
+    if (nodes.size() != 3) { throw_error("if: illegal syntax"); }
+    // Re-use CondNode for ifs as well.
+    auto it = nodes.begin();
+    node_ptr test = *it++, consequent = *it++, alternative = *it;
+    return std::make_unique<CondNode>(
+        // Predicates
+        ASTNode::node_list { test, std::make_unique<BoolNode>(true) },
+        // Bodies
+        ASTNode::node_list { consequent, alternative }
+    );
+}
 
-        // Note that a size of 1 represents 0 complete elements.
-        if (level.size() <= 1)
-            { throw_error("parser: failed to split s-expression"); }
+std::unique_ptr<ASTNode> Reader::form()
+{
+    // Unit
+    if (at(Token::Kind::close)) { ++it_; return std::make_unique<UnitNode>(); }
+
+    if (at("cons"))   { ++it_; return make_cons(elements()); }
+    if (at("list"))   { ++it_; return make_list(elements()); }
+    if (at("if"))     { ++it_; return make_if(elements()); }
+    if (at("cond"))   { ++it_; return parse_cond(); }
+    if (at("define")) { ++it_; return parse_define(); }
+    if (at("define-memo")) { ++it_; return parse_define_memo(); }
+    if (at("let"))    { ++it_; return parse_let(false); }
+    if (at("let*"))   { ++it_; return parse_let(true); }
+    if (at("lambda")) { ++it_; return parse_lambda(); }
+
+    // Procedure Call / Sequence / And / Or
+
+    // All sequence nodes have roughly the same structure.
+
+    if (at("begin")) { ++it_; return std::make_unique<SeqNode>(elements()); }
+    if (at("and"))   { ++it_; return std::make_unique<AndNode>(elements()); }
+    if (at("or"))    { ++it_; return std::make_unique<OrNode>(elements()); }
+    return std::make_unique<ProcNode>(elements());
+}
 
-        // Cons
-        if (*level[0] == "cons") {
-            if (level.size() != 4) { throw_error("cons: illegal syntax"); }
-            return std::make_unique<PairNode>(
-                parse_immediate(level[1], level[2]),
-                parse_immediate(level[2], level[3])
-            );
-        }
+std::unique_ptr<ASTNode> Reader::parse_cond()
+{
+    ASTNode::node_list pred;
+    ASTNode::node_list seq;
+
+    while (!at(Token::Kind::close)) {
+        open();
+        ASTNode::node_list clause = elements();
+        if (clause.size() != 2) { throw_error("cond: illegal condition list"); }
+        pred.push_back(clause.front());
+        seq.push_back(clause.back());
+    }
+    ++it_;
 
-        // List
-        if (*level[0] == "list") {
-            // Generate the nodes
-            std::list<std::unique_ptr<ASTNode>> nodes;
-            std::size_t l_ind = 1, r_ind = 2;
-            for (; r_ind < level.size(); ++l_ind, ++r_ind) {
-                nodes.emplace_back(parse_immediate(level[l_ind], level[r_ind]));
-            }
-            // Construct a list
-            return construct_list(nodes);
-        }
+    return std::make_unique<CondNode>(std::move(pred), std::move(seq));
+}
 
-        // If
-        if (*level[0] == "if") {
-            if (level.size() != 5) { throw_error("if: illegal syntax"); }
-            // Re-use CondNode for ifs as well.
-            return std::make_unique<CondNode>(
-                // Predicates
-                ASTNode::node_list { parse_immediate(level[1], level[2]),
-                    std::make_unique<BoolNode>(true) },
-                // Bodies
-                ASTNode::node_list { parse_immediate(level[2], level[3]),
-                  parse_immediate(level[3], level[4]) }
-            );
-        }
+std::unique_ptr<ASTNode> Reader::parse_define()
+{
+    if (at(Token::Kind::close)) { throw_error("define: illegal syntax"); }
 
-        // Cond
-        if (*level[0] == "cond") {
-            ASTNode::node_list pred;
-            ASTNode::node_list seq;
-
-            std::size_t l_ind = 1, r_ind = 2;
-            for (; r_ind < level.size(); ++l_ind, ++r_ind) {
-                auto pair = split_level(level[l_ind], level[r_ind]);
-                if (pair.size() != 3) { throw_error("cond: illegal condition list"); }
-                
-                pred.emplace_back(parse_immediate(pair[0], pair[1]));
-                seq.emplace_back(parse_immediate(pair[1], pair[2]));
-            }
-
-            return std::make_unique<CondNode>(std::move(pred), std::move(seq));
-        }
+    // Special function definition syntax
+    if (at(Token::Kind::open)) {
+        ++it_;
+        std::string name = identifier("lambda: illegal argument list");
+        std::vector<std::string> arg_list = arguments();
 
-        // Define
-        if (*level[0] == "define") {
-            if (level.size() != 4) { throw_error("define: illegal syntax"); }
+        ASTNode::node_list body = elements();
+        if (body.size() != 1) { throw_error("define: illegal syntax"); }
 
-            // Special function definition syntax
-            if (*level[1] == "(") {
-                std::vector<std::string> arg_list;
+        // Materialize
+        return std::make_unique<BindNode>(name,
+            std::make_unique<LambdaNode>(std::move(arg_list), body.front(), name)
+        );
+    }
 
-                auto arg_iter = split_level(level[1], level[2]);
+    // Binding a regular variable identifier
+    std::string name = identifier("define: illegal syntax");
+    ASTNode::node_list value = elements();
+    if (value.size() != 1) { throw_error("define: illegal syntax"); }
+    return std::make_unique<BindNode>(name, value.front());
+}
 
-                if (arg_iter.size() < 2) { throw_error("lambda: illegal argument list"); }
+// `(define-memo (name args...) body [size])` defines `name` as
+// `(memoize (lambda (args...) body) [size])`. The lambda is not
+// recursive: calls to `name` from its body go through the cache too.
+std::unique_ptr<ASTNode> Reader::parse_define_memo()
+{
+    open();
+    std::string name = identifier("define-memo: illegal syntax");
+    std::vector<std::string> arg_list = arguments();
 
-                std::size_t l_ind = 1, r_ind = 2;
-                for (; r_ind < arg_iter.size(); ++l_ind, ++r_ind) {
-                    // Disallow nesting and non-identifiers
-                    if ((std::distance(arg_iter[l_ind], arg_iter[r_ind]) != 1)
-                        || !is_identifier(*arg_iter[l_ind]))
-                        { throw_error("lambda: illegal argument list"); }
-                    arg_list.push_back(*arg_iter[l_ind]);
-                }
+    ASTNode::node_list body = elements();
+    if (body.empty() || body.size() > 2) { throw_error("define-memo: illegal syntax"); }
 
-                // Materialize
-                return std::make_unique<BindNode>( *arg_iter[0],
-                    std::make_unique<LambdaNode>(std::move(arg_list), parse_immediate(level[2], level[3]), *arg_iter[0])
-                );
+    ASTNode::node_list call { std::make_unique<VarNode>("memoize"),
+        std::make_unique<LambdaNode>(std::move(arg_list), body.front(), name, false) };
+    if (body.size() == 2) { call.push_back(body.back()); }
+    return std::make_unique<BindNode>(name, std::make_unique<ProcNode>(std::move(call)));
+}
 
-            // Binding a regular variable identifier
-            } else {
-                if (!is_identifier(*level[1])) { throw_error("define: illegal syntax"); }
-                return std::make_unique<BindNode>(*level[1], parse_immediate(level[2], level[3]));
-            }
-        }
+std::unique_ptr<ASTNode> Reader::parse_let(bool star)
+{
+    if (at(Token::Kind::close)) { throw_error("let: illegal syntax"); }
+
+    // Extract the bindings
+    std::vector<Env::kv_pair> bindings;
+
+    open();
+    while (!at(Token::Kind::close)) {
+        open();
+        std::string name = identifier("let: illegal binding list");
+        ASTNode::node_list value = elements();
+        if (value.size() != 1) { throw_error("let: illegal binding list"); }
+        bindings.emplace_back(name, value.front());
+    }
+    ++it_;
 
-        // Let[*]
-        if ((*level[0] == "let") || *level[0] == "let*") {
-            if (level.size() < 4) { throw_error("let: illegal syntax"); }
-            
-            // Extract the bindings
-            std::vector<Env::kv_pair> bindings;
-
-            auto pair_iter = split_level(level[1], level[2]);
-
-            std::size_t l_ind = 0, r_ind = 1;
-                for (; r_ind < pair_iter.size(); ++l_ind, ++r_ind) {
-                    auto pair = split_level(pair_iter[l_ind], pair_iter[r_ind]);
-                    if (pair.size() != 3 || !is_identifier(*pair_iter[l_ind])) { throw_error("let: illegal binding list"); }
-                    
-                    bindings.emplace_back(*pair[0], parse_immediate(pair[1], pair[2]));
-                }
+    // Extract the expression sequence
+    ASTNode::node_list nodes = elements();
+    if (nodes.empty()) { throw_error("let: illegal syntax"); }
 
-            // Extract the expression sequence
-            ASTNode::node_list nodes;
+    // Materialize
+    return std::make_unique<LetNode>(
+        std::move(bindings),
+        std::make_unique<SeqNode>(std::move(nodes)),
+        star
+    );
+}
 
-            l_ind = 2, r_ind = 3;
-            for (; r_ind < level.size(); ++l_ind, ++r_ind) {
-                nodes.emplace_back(parse_immediate(level[l_ind], level[r_ind]));
-            }
+std::unique_ptr<ASTNode> Reader::parse_lambda()
+{
+    if (at(Token::Kind::close)) { throw_error("lambda: illegal syntax"); }
 
-            // Materialize
-            return std::make_unique<LetNode>(
-                std::move(bindings),
-                std::make_unique<SeqNode>(std::move(nodes)),
-                *level[0] == "let*"
-            );
-        }
-        
-        // Lambda
-        if (*level[0] == "lambda") {
-            if (level.size() != 4) { throw_error("lambda: illegal syntax"); }
-            
-            // Parse argument list
-            std::vector<std::string> arg_list;
-
-            auto arg_iter = split_level(level[1], level[2]);
-
-            std::size_t l_ind = 0, r_ind = 1;
-            for (; r_ind < arg_iter.size(); ++l_ind, ++r_ind) {
-                // Disallow nesting and non-identifiers
-                if ((std::distance(arg_iter[l_ind], arg_iter[r_ind]) != 1)
-                    || !is_identifier(*arg_iter[l_ind]))
-                    { throw_error("lambda: illegal argument list"); }
-                arg_list.push_back(*arg_iter[l_ind]);
-            }
-
-            return std::make_unique<LambdaNode>(std::move(arg_list), parse_immediate(level[2], level[3]));
-        }
+    // Parse argument list
+    open();
+    std::vector<std::string> arg_list = arguments();
 
-        // Procedure Call / Sequence / And / Or
-        
-        // All sequence nodes have roughly the same structure.
-
-        ASTNode::node_list nodes;
-        
-        std::size_t l_ind = 0, r_ind = 1;
-        if (*level[0] == "begin" // Skip keyword
-            || *level[0] == "and"
-            || *level[0] == "or") { ++l_ind; ++r_ind; }
-        
-        for (; r_ind < level.size(); ++l_ind, ++r_ind) {
-            nodes.emplace_back(parse_immediate(level[l_ind], level[r_ind]));
-        }
+    ASTNode::node_list body = elements();
+    if (body.size() != 1) { throw_error("lambda: illegal syntax"); }
 
-        if (*level[0] == "begin")
-            { return std::make_unique<SeqNode>(std::move(nodes)); }
-        else if (*level[0] == "and")
-            { return std::make_unique<AndNode>(std::move(nodes)); }
-        else if (*level[0] == "or")
-            { return std::make_unique<OrNode>(std::move(nodes)); }
-        else
-            { return std::make_unique<ProcNode>(std::move(nodes)); } 
-        
-    } else {
-        // literal or identifier
-        if (end - begin != 1) { throw_error("parser: invalid s-expression"); }
-
-        // bool
-        if (*begin == "#t") { return std::make_unique<BoolNode>(true);  }
-        if (*begin == "#f") { return std::make_unique<BoolNode>(false); }
-
-        // integer
-        try { return std::make_unique<IntNode>(std::stoi(*begin)); }
-        catch (std::invalid_argument const &) { /* not an int */ }
-        catch (std::out_of_range const &) { throw_error("parser: integer too large"); }
-
-        // identifier
-        return std::make_unique<VarNode>(*begin);
-    }
+    return std::make_unique<LambdaNode>(std::move(arg_list), body.front());
 }
 
 // Precondition: SeqNode is empty.
 Parser::status
-Parser::parse(std::istream & src, SeqNode & dst)
+Parser::parse(std::string_view src, SeqNode & dst)
 {
 
     status result = tokenize(src);
@@ -377,24 +422,51 @@ Parser::parse(std::istream & src, SeqNode & dst)
     if (result != status::success) { return result; }
     if (tokens_.empty()) { return status::success; }
 
+    dst.sequence_.emplace_front(build());
+    return status::success;
+}
+
+Parser::status
+Parser::read(Source & src, SeqNode & dst)
+{
+    reset();
+    do {
+        if (tokenize(src.text(), true) == status::failure) { return status::failure; }
+        if (paren_ == 0 && !tokens_.empty()) {
+            dst.sequence_.emplace_front(build());
+            return status::success;
+        }
+    } while (src.refill());
+
+    if (paren_ != 0) {
+        throw_error("parser: input does not form a valid expression");
+    }
+    return status::success;
+}
+
+node_ptr Parser::build() const
+{
     // Note:
     // I am using a mix of a custom error return type and
     // exceptions here in order to keep exceptions out of
     // the critical path of the parsing mechanism.
 
     try {
-        dst.sequence_.emplace_front(
-            parse_immediate(tokens_.cbegin(), tokens_.cend())
-        );
-        return status::success;
+        Reader reader(tokens_.cbegin(), tokens_.cend());
+        node_ptr node = reader.element();
+        if (!reader.done()) { throw_error("parser: invalid s-expression"); }
+        // Resolve local identifiers to lexical addresses.
+        Scope scope(builtins_);
+        node->resolve(scope);
+        if (optimize_) { node = Optimizer().optimize(node); }
+        return node;
     } catch (std::string const & e) {
         throw; // If we have an error here, we can handle it in main.
     } catch (...) {
         throw_error("immediate parsing failed");
     }
 
-    return status::failure;
-
+    return nullptr;
 }
 
 }
@@ -0,0 +1,171 @@
+#include "li/profile.hpp"
+#include "li/heap.hpp"
+
+#include <algorithm>
+#include <format>
+#include <map>
+
+#include <signal.h>
+#include <sys/time.h>
+
+namespace lisp {
+
+namespace interpreter {
+
+Profiler & profiler()
+{
+	static Profiler instance;
+	return instance;
+}
+
+void Profiler::trace()
+{
+	tracing_ = true;
+	enabled = true;
+}
+
+bool Profiler::sample(std::chrono::microseconds interval)
+{
+	// Allocated up front: the signal handler cannot allocate.
+	samples_ = std::make_unique_for_overwrite<Sample[]>(max_samples);
+	sampled_ = std::make_unique_for_overwrite<Call[]>(max_sampled_calls);
+	sampling_ = true;
+	enabled = true;
+
+	struct sigaction action {};
+	action.sa_handler = on_timer;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, nullptr) != 0) { return false; }
+
+	itimerval timer {};
+	timer.it_interval.tv_sec = interval.count() / 1000000;
+	timer.it_interval.tv_usec = interval.count() % 1000000;
+	timer.it_value = timer.it_interval;
+	return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+void Profiler::stop()
+{
+	itimerval timer {};
+	setitimer(ITIMER_PROF, &timer, nullptr);
+	signal(SIGPROF, SIG_IGN);
+}
+
+void Profiler::enter(std::string_view name, Kind kind)
+{
+	if (sampling_) {
+		std::size_t depth = depth_.load(std::memory_order_relaxed);
+		if (depth < max_depth) { calls_[depth] = { name.data(), static_cast<std::uint32_t>(name.size()), kind }; }
+		std::atomic_signal_fence(std::memory_order_release);
+		depth_.store(depth + 1, std::memory_order_relaxed);
+	}
+	if (!tracing_) { return; }
+
+	entry_map & entries = kind == Kind::lambda ? lambdas_ : builtins_;
+	auto it = entries.find(name);
+	if (it == entries.end()) { it = entries.emplace(name, Entry()).first; }
+
+	Entry & entry = it->second;
+	++entry.calls;
+	++entry.active;
+	frames_.push_back({ &entry, clock::now(), {}, heap().stats().objects });
+}
+
+void Profiler::exit()
+{
+	if (sampling_) { depth_.store(depth_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed); }
+	if (!tracing_) { return; }
+
+	Frame frame = frames_.back();
+	frames_.pop_back();
+
+	clock::duration elapsed = clock::now() - frame.start;
+	std::size_t allocations = heap().stats().objects - frame.allocations;
+
+	Entry & entry = *frame.entry;
+	entry.exclusive += elapsed - frame.children;
+	entry.allocations += allocations - frame.child_allocations;
+	if (--entry.active == 0) { entry.inclusive += elapsed; }
+
+	if (!frames_.empty()) {
+		frames_.back().children += elapsed;
+		frames_.back().child_allocations += allocations;
+	}
+}
+
+void Profiler::on_timer(int) { profiler().take_sample(); }
+
+// Runs in the signal handler: copies the stack, and nothing else.
+void Profiler::take_sample()
+{
+	std::size_t depth = depth_.load(std::memory_order_relaxed);
+	std::atomic_signal_fence(std::memory_order_acquire);
+	std::size_t named = std::min(depth, max_depth);
+	std::size_t kept = std::min(named, max_sample_depth);
+	if (sample_count_ == max_samples || sampled_count_ + kept > max_sampled_calls) {
+		++dropped_;
+		return;
+	}
+
+	samples_[sample_count_++] = { depth, sampled_count_, kept };
+	for (std::size_t i = named - kept; i < named; ++i) { sampled_[sampled_count_++] = calls_[i]; }
+}
+
+std::string Profiler::frame_name(std::string_view name, Kind kind)
+{
+	if (kind == Kind::builtin) { return std::format("builtin {}", name); }
+	return name.empty() ? std::string("(lambda)") : std::string(name);
+}
+
+void Profiler::report(std::ostream & os) const
+{
+	struct Row {
+		std::string name;
+		const Entry * entry;
+	};
+	std::vector<Row> rows;
+	for (auto const & [name, entry] : lambdas_) { rows.push_back({ frame_name(name, Kind::lambda), &entry }); }
+	for (auto const & [name, entry] : builtins_) { rows.push_back({ frame_name(name, Kind::builtin), &entry }); }
+
+	// Most expensive first
+	std::sort(rows.begin(), rows.end(), [](const Row & a, const Row & b) {
+		return a.entry->exclusive > b.entry->exclusive;
+	});
+
+	auto ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+	os << std::format("profile: {:<24} {:>10} {:>14} {:>14} {:>12}\n",
+	                  "procedure", "calls", "inclusive ms", "exclusive ms", "allocations");
+	for (auto const & row : rows) {
+		os << std::format("profile: {:<24} {:>10} {:>14.3f} {:>14.3f} {:>12}\n", row.name, row.entry->calls,
+		                  ms(row.entry->inclusive), ms(row.entry->exclusive), row.entry->allocations);
+	}
+	os.flush();
+}
+
+void Profiler::write_samples(std::ostream & os)
+{
+	stop();
+
+	// Samples outside of any call are of the top level itself. Calls left
+	// out of a sample, outside or inside the ones kept, are shown as "...".
+	std::map<std::string, std::size_t> stacks;
+	for (std::size_t i = 0; i < sample_count_; ++i) {
+		const Sample & sample = samples_[i];
+		std::size_t named = std::min(sample.depth, max_depth);
+		std::string stack = sample.depth == 0 ? "(top level)" : named > sample.kept ? "..." : "";
+		for (std::size_t j = 0; j < sample.kept; ++j) {
+			const Call & call = sampled_[sample.first + j];
+			if (!stack.empty()) { stack += ';'; }
+			stack += frame_name(std::string_view(call.name, call.size), call.kind);
+		}
+		if (sample.depth > named) { stack += ";..."; }
+		++stacks[stack];
+	}
+	for (auto const & [stack, count] : stacks) { os << stack << ' ' << count << '\n'; }
+	os.flush();
+}
+
+}
+
+}
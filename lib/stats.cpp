@@ -0,0 +1,54 @@
+#include "li/stats.hpp"
+#include "li/heap.hpp"
+
+#include <format>
+
+#include <sys/resource.h>
+
+namespace lisp {
+
+namespace interpreter {
+
+namespace {
+
+constexpr const char * node_names[] = {
+	"integer", "boolean", "unit", "seq", "var", "bind", "let",
+	"proc", "lambda", "pair", "cond", "and", "or", "bignum",
+};
+static_assert(std::size(node_names) == node_kinds);
+
+}
+
+std::vector<std::pair<std::string, std::size_t>> runtime_stats_table()
+{
+	auto const & stats = runtime_stats();
+	std::vector<std::pair<std::string, std::size_t>> table;
+
+	std::size_t nodes = 0;
+	for (std::size_t count : stats.nodes) { nodes += count; }
+	table.emplace_back("nodes", nodes);
+	for (std::size_t kind = 0; kind < node_kinds; ++kind) {
+		table.emplace_back(std::format("nodes-{}", node_names[kind]), stats.nodes[kind]);
+	}
+
+	table.emplace_back("lookups-local", stats.local_lookups);
+	table.emplace_back("lookups-top-level", stats.top_level_lookups);
+	table.emplace_back("lookups-builtin", stats.builtin_lookups);
+	table.emplace_back("global-cache-misses", stats.global_cache_misses);
+	table.emplace_back("frames", stats.frames);
+	table.emplace_back("max-depth", stats.max_depth);
+	table.emplace_back("memo-hits", stats.memo_hits);
+	table.emplace_back("memo-misses", stats.memo_misses);
+	table.emplace_back("objects-allocated", heap().stats().objects);
+	table.emplace_back("parse-us", static_cast<std::size_t>(stats.parse_us));
+	table.emplace_back("eval-us", static_cast<std::size_t>(stats.eval_us));
+
+	rusage usage {};
+	getrusage(RUSAGE_SELF, &usage);
+	table.emplace_back("peak-rss-kb", static_cast<std::size_t>(usage.ru_maxrss));
+	return table;
+}
+
+}
+
+}
@@ -0,0 +1,154 @@
+#include "li/value.hpp"
+#include "li/ast.hpp"
+#include "li/heap.hpp"
+#include "li/number.hpp"
+#include "li/profile.hpp"
+#include "li/utility.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace lisp {
+
+namespace interpreter {
+
+Value Object::call(value_span)
+{
+	throw_error("non-callable type cannot be called");
+	return Value();
+}
+
+Value Object::call_tail(value_span args, TailCall &) { return call(args); }
+
+Value Object::get(std::size_t) const
+{
+	throw_error("cannot get element of non-pair type");
+	return Value();
+}
+
+int Value::get_numeric() const
+{
+	if (is_bignum()) { throw_error("runtime: integer too large"); }
+	if (!is_fixnum()) { throw_error("non-numeric type cannot be interpreted as an integer"); }
+	return fixnum();
+}
+
+Value Value::call(value_span args) const
+{
+	if (!is_object()) { throw_error("non-callable type cannot be called"); }
+	return object()->call(args);
+}
+
+Value Value::get(std::size_t idx) const
+{
+	if (!is_object()) { throw_error("cannot get element of non-pair type"); }
+	return object()->get(idx);
+}
+
+std::string Value::to_string() const
+{
+	switch (tag()) {
+		case number_tag:  return std::to_string(fixnum());
+		case boolean_tag: return std::string(get_boolean() ? "#t" : "#f");
+		case unit_tag:    return std::string("()");
+		case null_tag: {
+			auto name = reinterpret_cast<const std::string *>(bits_ & ~tag_mask);
+			return name ? *name : std::string();
+		}
+		default: return object()->to_string();
+	}
+}
+
+std::ostream& operator<<(std::ostream & os, const Value & value)
+{
+	os << value.to_string();
+	return os;
+}
+
+// Looked up by string_view, so that interning a known name does not allocate.
+struct NameHash {
+	using is_transparent = void;
+	std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
+const std::string * intern(std::string_view name)
+{
+	static std::unordered_set<std::string, NameHash, std::equal_to<>> names;
+	auto it = names.find(name);
+	if (it == names.end()) { it = names.emplace(name).first; }
+	return &*it;
+}
+
+Value symbol(std::string_view name)
+{
+	static std::unordered_map<const std::string *, Value> symbols;
+	const std::string * interned = intern(name);
+	auto it = symbols.find(interned);
+	if (it == symbols.end()) { it = symbols.emplace(interned, pin(make_object<Symbol>(*interned))).first; }
+	return it->second;
+}
+
+Pair::Pair(Value l, Value r) : first_(l), second_(r) { }
+void Pair::trace(Heap & heap) const
+{
+	heap.mark(first_);
+	heap.mark(second_);
+}
+Value Pair::get(std::size_t idx) const { return idx == 0 ? first_ : second_; }
+std::string Pair::to_string() const { return to_string_internal(); }
+std::string Pair::to_string_internal(bool outer) const
+{
+	// Logic for representing pairs and lists accurately.
+	bool il = is_list(second_);
+	std::string out = "";
+	if (!il || outer) { out += "("; }
+	out += first_.is_pair()
+	    ? static_cast<const Pair *>(first_.object())->to_string_internal(true)
+	    : first_.to_string();
+	if (!second_.is_unit()) {
+		out += il ? " " : " . ";
+		out += second_.is_pair()
+			? static_cast<const Pair *>(second_.object())->to_string_internal(false)
+			: second_.to_string();
+	}
+	if (!il || outer) { out += ")"; }
+	return out;
+}
+
+Vector::Vector(std::size_t length, Value fill) : elements_(length, fill) { }
+Vector::Vector(std::vector<Value> && elements) : elements_(std::move(elements)) { }
+void Vector::trace(Heap & heap) const
+{
+	for (auto const & element : elements_) { heap.mark(element); }
+}
+std::string Vector::to_string() const
+{
+	std::string out = "#(";
+	for (std::size_t i = 0; i < elements_.size(); ++i) {
+		if (i) { out += " "; }
+		out += elements_[i].to_string();
+	}
+	return out + ")";
+}
+
+Builtin::Builtin(const std::string fname, Builtin::builtin_fxn func) : Object(Kind::builtin), name_(fname), fxn_(func) { }
+Value Builtin::call(value_span args)
+{
+	ProfileScope profile(name_, Profiler::Kind::builtin);
+	return fxn_(args);
+}
+std::string Builtin::to_string() const { return std::string("#<Builtin>: ") + name_; }
+
+// Check if a value can be interpreted as a valid list.
+bool is_list(const Value & value)
+{
+	Value node = value;
+	while (node.is_pair()) { node = node.get(1); }
+	return node.is_unit();
+}
+
+}
+
+}
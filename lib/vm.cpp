@@ -0,0 +1,244 @@
+#include "li/vm.hpp"
+#include "li/ast.hpp"
+#include "li/profile.hpp"
+#include "li/stats.hpp"
+#include "li/utility.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <memory>
+
+namespace lisp {
+
+namespace interpreter {
+
+VMClosure::VMClosure(std::shared_ptr<const Function> function, VM & vm, std::vector<Value> && captured)
+	: Object(Kind::vm_closure), function_(std::move(function)), vm_(vm), captured_(std::move(captured)) { }
+Value VMClosure::call(value_span args) { return vm_.call(*this, args); }
+std::string VMClosure::to_string() const { return function_->lambda->to_string(); }
+void VMClosure::trace(Heap & heap) const
+{
+	for (auto const & value : captured_) { heap.mark(value); }
+}
+
+VM::VM(Env & env) : env_(env), instrumented_(RuntimeStats::enabled || Profiler::enabled)
+{
+	stack_.reserve(stack_capacity);
+	heap().add_root(&stack_);
+}
+VM::~VM() { heap().remove_root(&stack_); }
+
+Value VM::run(ASTNode & program)
+{
+	Compiler compiler;
+	std::shared_ptr<const Function> script = compiler.compile(program);
+	return run(*script);
+}
+
+Value VM::run(const Function & script)
+{
+	// Top-level forms run in a frame of their own (for `let` slots),
+	// below an empty callee slot like any other call.
+	std::size_t sp = stack_.size();
+	std::size_t depth = frames_.size();
+	reserve(1 + script.locals + script.code.size());
+	stack_.emplace_back();
+	stack_.resize(sp + 1 + script.locals);
+	frames_.push_back({ &script, 0, sp + 1, nullptr });
+
+	try { return execute(depth); }
+	catch (...) { unwind(depth, sp); throw; }
+}
+
+Value VM::call(VMClosure & closure, value_span args)
+{
+	std::size_t sp = stack_.size();
+	std::size_t depth = frames_.size();
+	reserve(1 + args.size());
+	stack_.push_back(Value(&closure));
+	std::copy(args.begin(), args.end(), std::back_inserter(stack_));
+
+	try {
+		enter(closure, sp + 1, args.size());
+		return execute(depth);
+	} catch (...) { unwind(depth, sp); throw; }
+}
+
+// Discard the frames and values of an aborted run.
+void VM::unwind(std::size_t depth, std::size_t sp)
+{
+	if (Profiler::enabled) {
+		for (std::size_t i = depth; i < frames_.size(); ++i) {
+			if (frames_[i].closure) { profiler().exit(); }
+		}
+	}
+	frames_.resize(depth);
+	stack_.resize(sp);
+}
+
+// Make sure `count` more values fit on the stack without reallocating.
+void VM::reserve(std::size_t count) const
+{
+	if (stack_capacity - stack_.size() < count) { throw_error("runtime: stack overflow"); }
+}
+
+// Push a frame for `closure`, whose arguments start at `base`. Every
+// instruction pushes at most one value, so the frame's operands need
+// no more slots than its code has instructions.
+void VM::enter(VMClosure & closure, std::size_t base, std::size_t argc)
+{
+	const Function & function = *closure.function_;
+	if (argc != function.arity) {
+		throw_error(std::format("runtime: lambda function requires {} args; called with {}", function.arity, argc));
+	}
+
+	reserve(base + function.locals + function.code.size() - stack_.size());
+	stack_.resize(base + function.locals);
+	if (function.named) { stack_[base + function.arity] = stack_[base - 1]; }
+	frames_.push_back({ &function, 0, base, &closure });
+	if (instrumented_) {
+		if (RuntimeStats::enabled) {
+			++runtime_stats().frames;
+			runtime_stats().reached(frames_.size() - 1); // below the top-level frame
+		}
+		if (Profiler::enabled) { profiler().enter(function.lambda->name(), Profiler::Kind::lambda); }
+	}
+	heap().safepoint();
+}
+
+// Referencing an empty result is an error, as in `VarNode::eval`.
+static const Value & checked(const Value & value)
+{
+	if (value.is_null()) { throw_error("runtime: cannot evaluate empty return type"); }
+	return value;
+}
+
+// Run until the frame at index `depth` returns.
+Value VM::execute(std::size_t depth)
+{
+	CallFrame * frame = &frames_.back();
+	const Instruction * code = frame->function->code.data();
+
+	for (;;) {
+		const Instruction ins = code[frame->ip++];
+		switch (ins.op) {
+			case Op::constant:
+				stack_.push_back(frame->function->constants[ins.arg]);
+				break;
+			case Op::local:
+				if (RuntimeStats::enabled) { ++runtime_stats().local_lookups; }
+				stack_.push_back(checked(stack_[frame->base + ins.arg]));
+				break;
+			case Op::captured:
+				if (RuntimeStats::enabled) { ++runtime_stats().local_lookups; }
+				stack_.push_back(checked(frame->closure->captured_[ins.arg]));
+				break;
+			case Op::global:
+				stack_.push_back(checked(env_.find(frame->function->names[ins.arg], frame->function->builtins[ins.arg],
+				                                   frame->function->caches[ins.arg])));
+				break;
+			case Op::define: {
+				auto const & name = frame->function->names[ins.arg];
+				env_.define(name, std::move(stack_.back()));
+				stack_.back() = Value::null(intern(name));
+				break;
+			}
+			case Op::set_local:
+				stack_[frame->base + ins.arg] = std::move(stack_.back());
+				stack_.pop_back();
+				break;
+			case Op::pop:
+				stack_.pop_back();
+				break;
+			case Op::null:
+				stack_.emplace_back();
+				break;
+			case Op::jump:
+				frame->ip = ins.arg;
+				break;
+			case Op::folded:
+				if (Env::builtin_redefined()) { frame->ip = ins.arg; }
+				break;
+			case Op::jump_if_false: {
+				bool test = stack_.back().get_boolean();
+				stack_.pop_back();
+				if (!test) { frame->ip = ins.arg; }
+				break;
+			}
+			case Op::jump_if_false_keep:
+				if (!stack_.back().get_boolean()) { frame->ip = ins.arg; }
+				else { stack_.pop_back(); }
+				break;
+			case Op::jump_if_true_keep:
+				if (stack_.back().get_boolean()) { frame->ip = ins.arg; }
+				else { stack_.pop_back(); }
+				break;
+			case Op::cons: {
+				Value second = std::move(stack_.back());
+				stack_.pop_back();
+				stack_.back() = make_object<Pair>(std::move(stack_.back()), std::move(second));
+				break;
+			}
+			case Op::closure: {
+				auto const & function = frame->function->functions[ins.arg];
+				auto first = stack_.end() - function->captures;
+				std::vector<Value> captured(std::make_move_iterator(first), std::make_move_iterator(stack_.end()));
+				stack_.erase(first, stack_.end());
+				stack_.push_back(make_object<VMClosure>(function, *this, std::move(captured)));
+				break;
+			}
+			case Op::call:
+			case Op::tail_call: {
+				std::size_t base = stack_.size() - ins.arg;
+				const Value & proc = stack_[base - 1];
+				auto kind = proc.is_object() ? proc.object()->kind() : Object::Kind::other;
+
+				if (kind == Object::Kind::vm_closure) {
+					auto & closure = static_cast<VMClosure &>(*proc.object());
+					if (ins.op == Op::tail_call) {
+						// Slide the callee and its arguments over the current frame.
+						std::size_t target = frame->base;
+						std::move(stack_.begin() + base - 1, stack_.end(), stack_.begin() + target - 1);
+						stack_.resize(target + ins.arg);
+						if (Profiler::enabled && frame->closure) { profiler().exit(); }
+						frames_.pop_back();
+						base = target;
+					}
+					enter(closure, base, ins.arg);
+					frame = &frames_.back();
+					code = frame->function->code.data();
+					break;
+				}
+
+				// Builtins (and non-procedures, which report an error). Only
+				// calls that are profiled need to go through `Builtin::call`.
+				value_span args = value_span(stack_).subspan(base);
+				Value result = kind == Object::Kind::builtin && !Profiler::enabled
+				               ? static_cast<Builtin &>(*proc.object()).function()(args)
+				               : proc.call(args);
+				// It may have run closures (for `memoize`), moving the frames.
+				frame = &frames_.back();
+				stack_.resize(base - 1);
+				stack_.push_back(std::move(result));
+				if (ins.op == Op::call) { break; }
+				[[fallthrough]];
+			}
+			case Op::ret: {
+				Value result = std::move(stack_.back());
+				stack_.resize(frame->base - 1);
+				if (Profiler::enabled && frame->closure) { profiler().exit(); }
+				frames_.pop_back();
+				if (frames_.size() == depth) { return result; }
+				stack_.push_back(std::move(result));
+				frame = &frames_.back();
+				code = frame->function->code.data();
+				break;
+			}
+		}
+	}
+}
+
+}
+
+}
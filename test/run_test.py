@@ -4,11 +4,95 @@ import subprocess
 import glob
 import sys
 import os
+import re
+import tempfile
 
 import pathlib
 
 # USAGE ./test/run_test.py ./tmp/lisp test/
 
+# Every test is run on each engine, with and without the optimizer, all
+# of which must print the same output.
+configurations = [
+	["--engine=ast"],
+	["--engine=vm"],
+	["--engine=ast", "-O0"],
+	["--engine=vm", "-O0"],
+]
+
+# A test can also have comment lines of its own, directing how it is run:
+#   ; run: FLAGS     run it with FLAGS (after the configuration's); with
+#                    several, it is run with each
+#   ; ignore: REGEX  replace text matching REGEX, in what it prints and
+#                    what it should print, by `...` before comparing them
+#   ; check: NAME    check more than its output, with one of the checks
+#                    below. Each runs the test its own way, and returns its
+#                    output, or raises an error explaining what went wrong.
+
+def run(binary, flags, test):
+	return subprocess.check_output([binary] + flags + [test])
+
+# Run with a cache directory: the first run saves the image, the second
+# loads it (and so leaves it alone), and runs on a damaged image (cut
+# short, or with a bit flipped every few bytes) must reject it, printing
+# the same, and replace it.
+def check_cache(binary, flags, test):
+	with tempfile.TemporaryDirectory() as cache_dir:
+		flags = flags + ["--cache-dir=" + cache_dir]
+		outputs = [run(binary, flags, test)]
+		images = glob.glob(cache_dir + "/*")
+		if len(images) != 1:
+			raise RuntimeError(f"expected one image in the cache, found {len(images)}")
+		image = pathlib.Path(images[0])
+		saved = image.read_bytes()
+
+		inode = image.stat().st_ino
+		outputs.append(run(binary, flags, test))
+		if image.stat().st_ino != inode:
+			raise RuntimeError("image was saved again instead of being loaded")
+
+		damaged = [("truncated", saved[:len(saved) // 2])]
+		for i in range(0, len(saved), 7):
+			damaged.append((f"corrupted (byte {i})", saved[:i] + bytes([saved[i] ^ 1]) + saved[i + 1:]))
+		for name, data in damaged:
+			image.write_bytes(data)
+			inode = image.stat().st_ino
+			try:
+				outputs.append(run(binary, flags, test))
+			except subprocess.CalledProcessError as error:
+				raise RuntimeError(f"{name} image: {error}")
+			if image.stat().st_ino == inode or image.read_bytes() != saved:
+				raise RuntimeError(f"{name} image was not replaced")
+
+		if any(output != outputs[0] for output in outputs):
+			raise RuntimeError("runs printed different output: " + " / ".join(repr(output.decode()) for output in outputs))
+		return outputs[0]
+
+# Run with `--profile-samples`: the samples must be folded stacks, one
+# line per distinct stack of non-empty names, with a positive count, and
+# some must be of the test's `spin` procedure called from `outer`.
+def check_profile_samples(binary, flags, test):
+	with tempfile.TemporaryDirectory() as samples_dir:
+		path = samples_dir + "/samples.folded"
+		output = run(binary, flags + ["--profile-samples=" + path], test)
+		lines = pathlib.Path(path).read_text().splitlines()
+	stacks = set()
+	for line in lines:
+		match = re.fullmatch(r"([^;]+(?:;[^;]+)*) ([1-9][0-9]*)", line)
+		if not match:
+			raise RuntimeError(f"malformed sample line: {line!r}")
+		if match[1] in stacks:
+			raise RuntimeError(f"stack sampled on several lines: {match[1]!r}")
+		stacks.add(match[1])
+	if not any(stack.startswith("outer;spin") for stack in stacks):
+		raise RuntimeError("no samples of outer;spin in: " + ", ".join(sorted(stacks)))
+	return output
+
+checks = {
+	"cache": check_cache,
+	"profile-samples": check_profile_samples,
+}
+
 if __name__ == "__main__":
 	binary = sys.argv[1]
 	test_dir = sys.argv[2]
@@ -17,15 +101,35 @@ if __name__ == "__main__":
 	tests = glob.glob(test_dir + "src/*.lsp")
 
 	# Run tests
-	n_tests  = len(tests)
+	n_tests  = 0
 	n_passed = 0
 	for test in tests:
 		test_name = os.path.split(test)[-1]
-		print(f"Runnning test {test_name}...", end="")
-		
-		result = subprocess.check_output([binary, test])
 		with open(test_dir + "out/" + test_name[:-3] + "out", "rb") as f:
 			expected = f.read()
+		with open(test, "rb") as f:
+			source = f.read().decode()
+		runs = [line.split() for line in re.findall(r"^; run:(.*)$", source, re.MULTILINE)] or [[]]
+		ignored = re.findall(r"^; ignore: (.*)$", source, re.MULTILINE)
+		names = re.findall(r"^; check: (\S+)", source, re.MULTILINE)
+		check = checks[names[0]] if names else run
+
+		def mask(output):
+			for pattern in ignored:
+				output = re.sub(pattern.encode(), b"...", output)
+			return output
+		expected = mask(expected)
+
+		for flags in [configuration + extra for configuration in configurations for extra in runs]:
+			print(f"Runnning test {test_name} {' '.join(flags)}...", end="")
+			n_tests += 1
+
+			try:
+				result = mask(check(binary, flags, test))
+			except RuntimeError as error:
+				print("FAILED")
+				print(error)
+				continue
 			if expected != result:
 				print("FAILED")
 				print("Expected:")
@@ -0,0 +1,20 @@
+(define d display)(define n newline)
+(d (+ 2147483647 1))(n)
+(d (- -2147483648 1))(n)
+(d (* 65536 65536))(n)
+(d (- (* 65536 65536) 4294967295))(n)
+(d (integer? (* 65536 65536)))(n)
+(d (expt 2 100))(n)
+(d (expt -3 41))(n)
+(d (expt 2 -1))(n)
+(d (define (fact x) (if (= x 0) 1 (* x (fact (- x 1))))))(n)
+(d (fact 30))(n)
+(d (/ (fact 30) (fact 28)))(n)
+(d (modulo (fact 30) 1000000007))(n)
+(d (modulo (- 0 (fact 25)) 1000000007))(n)
+(d (< (fact 20) (fact 21) 123456789012345678901234567890))(n)
+(d (= (fact 20) 2432902008176640000))(n)
+(d (max 1 (fact 15) -99999999999999999999))(n)
+(d (abs -99999999999999999999))(n)
+(d (zero? (- (fact 22) (fact 22))))(n)
+(d (list 18446744073709551616 -18446744073709551616))(n)
@@ -0,0 +1,19 @@
+(define d display)(define n newline)
+(d (define v (make-vector 5)))(n)
+(d v)(n)
+(d (vector-length v))(n)
+(d (vector-set! v 0 #t))(n)
+(d v)(n)
+(d (vector 1 (list 2 3) (vector 4 5) #t))(n)
+(d (vector))(n)
+(d (vector? v))(n)
+(d (vector? (list 1 2)))(n)
+(d (list? v))(n)
+(d (define squares (make-vector 10 0)))(n)
+(d (define (fill i) (if (= i 10) squares (begin (vector-set! squares i (* i i)) (fill (+ i 1))))))(n)
+(d (fill 0))(n)
+(d (vector-ref squares 7))(n)
+(d (vector->list squares))(n)
+(d (list->vector (list 1 2 3)))(n)
+(d (vector->list (list->vector ())))(n)
+(d (make-vector 3 (vector 0)))(n)
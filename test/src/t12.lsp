@@ -0,0 +1,25 @@
+(define d display)(define n newline)
+(d (define (iota-from i acc) (if (< i 0) acc (iota-from (- i 1) (cons i acc)))))(n)
+(d (define v (list->vector (iota-from 10 ()))))(n)
+(d (vector-sum v))(n)
+(d (vector-min v))(n)
+(d (vector-max v))(n)
+(d (vector-add v v))(n)
+(d (vector-scale v -3))(n)
+(d (vector-dot v v))(n)
+(d (vector-sum (vector)))(n)
+(d (vector-dot (vector) (vector)))(n)
+(d (define big (vector 2147483647 2147483647 2147483647 2147483647 2147483647 -2147483648 -2147483648 1 2)))(n)
+(d (vector-sum big))(n)
+(d (vector-add big big))(n)
+(d (vector-scale big 2147483647))(n)
+(d (vector-dot big big))(n)
+(d (vector-max (vector 3 99999999999999999999 -4 5 6 7 8 9 10)))(n)
+(d (vector-min (vector 3 -99999999999999999999 -4 5 6 7 8 9 10)))(n)
+(d (vector-scale (vector 1 -2 3) 10000000000))(n)
+(d (+ 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17))(n)
+(d (+ 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647 2147483647))(n)
+(d (+ 1 2 3 4 5 6 7 8 99999999999999999999))(n)
+(d (max 5 -2 17 3 9 0 -40 12 8))(n)
+(d (min 5 -2 17 3 9 0 -40 12 8))(n)
+(d (max 5 -2 17 3 9 0 -40 12 99999999999999999999))(n)
@@ -0,0 +1,32 @@
+(define d display)(define n newline)
+(d (define h (make-hash-table)))(n)
+(d h)(n)
+(d (hash-table? h))(n)
+(d (hash-table? (list 1)))(n)
+(d (hash-set! h 1 100))(n)
+(d (hash-set! h (list 1 2) #t))(n)
+(d (hash-set! h #f 3))(n)
+(d (hash-set! h 99999999999999999999 (list 4)))(n)
+(d (hash-count h))(n)
+(d (hash-ref h 1))(n)
+(d (hash-ref h (cons 1 (cons 2 ()))))(n)
+(d (hash-ref h #f))(n)
+(d (hash-ref h (+ 99999999999999999998 1)))(n)
+(d (hash-ref h 2 -1))(n)
+(d (hash-set! h 1 101))(n)
+(d (hash-ref h 1))(n)
+(d (hash-remove! h (list 1 2)))(n)
+(d (hash-ref h (list 1 2) #f))(n)
+(d (hash-count h))(n)
+(d (hash-remove! h 12345))(n)
+(d (define (fill i) (if (= i 1000) h (begin (hash-set! h (cons i i) (* i i)) (fill (+ i 1))))))(n)
+(d (fill 0))(n)
+(d (hash-ref h (cons 999 999)))(n)
+(d (define (drop i) (if (= i 1000) h (begin (hash-remove! h (cons i i)) (drop (+ i 2))))))(n)
+(d (drop 0))(n)
+(d (hash-ref h (cons 998 998) #f))(n)
+(d (hash-ref h (cons 997 997) #f))(n)
+(d (define small (make-hash-table)))(n)
+(d (hash-set! small 7 8))(n)
+(d (hash-keys small))(n)
+(d (hash->list small))(n)
@@ -0,0 +1,29 @@
+(define d display)(define n newline)
+(d (define-memo (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))(n)
+(d (fib 90))(n)
+(d (memo-stats fib))(n)
+(d (fib 90))(n)
+(d (memo-stats fib))(n)
+(d (define (slow-square x) (begin (d x) (n) (* x x))))(n)
+(d (define square (memoize slow-square)))(n)
+(d (square 12))(n)
+(d (square 12))(n)
+(d (memo-stats square))(n)
+(d (define-memo (path-count x y) (if (or (= x 0) (= y 0)) 1 (+ (path-count (- x 1) y) (path-count x (- y 1))))))(n)
+(d (path-count 20 20))(n)
+(d (define-memo (sum-list lst) (if (null? lst) 0 (+ (car lst) (sum-list (cdr lst))))))(n)
+(d (sum-list (list 1 2 3)))(n)
+(d (sum-list (list 1 2 3)))(n)
+(d (memo-stats sum-list))(n)
+(d (define-memo (bounded k) (* k k) 2))(n)
+(d (bounded 1))(n)
+(d (bounded 2))(n)
+(d (bounded 1))(n)
+(d (bounded 3))(n)
+(d (memo-stats bounded))(n)
+(d (bounded 1))(n)
+(d (bounded 2))(n)
+(d (memo-stats bounded))(n)
+(d (define hit-count (car (memo-stats fib))))(n)
+(d (car hit-count))(n)
+(d (+ (cdr hit-count) 1))(n)
@@ -0,0 +1,22 @@
+(define d display)(define n newline)
+(d (* 60 60 24))(n)
+(d (+ 1 (* 2 3) (- 10 4)))(n)
+(d (* 65536 65536 65536))(n)
+(d (if (< 1 2) 10 20))(n)
+(d (if #t 1 (car 5)))(n)
+(d (if #f (car 5) 2))(n)
+(d (cond (#f 1) ((= 1 1) 2) (#t 3) (else 4)))(n)
+(d (cond (#f 1)))(n)
+(d (begin 1 (begin 2 (begin) 3) (begin (d 4) 5)))(n)
+(d (and 1 (and 2 #t) (and) 3))(n)
+(d (and 1 (and #f (car 5)) 3))(n)
+(d (or #f (or #f #f) 7 (car 5)))(n)
+(d (or #f (or) (and #f)))(n)
+(d (define (day-seconds days) (* days (* 60 (* 60 24)))))(n)
+(d (day-seconds 7))(n)
+(d (define (sign x) (cond ((< x 0) -1) ((> x 0) 1) ((zero? 0) 0) (#t 99))))(n)
+(d (sign -5))(d (sign 0))(d (sign 5))(n)
+(d (define (* a b) (+ a b)))(n)
+(d (day-seconds 7))(n)
+(d (* 60 60))(n)
+(d (/ 1 0))(n)
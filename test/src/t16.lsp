@@ -0,0 +1,24 @@
+(define d display)(define n newline)
+(d (define (greet) (hello)))(n)
+(d (define (hello) 1))(n)
+(d (greet))(n)
+(d (define (hello) 2))(n)
+(d (greet))(n)
+(d (define (count-down k) (if (= k 0) (hello) (count-down (- k 1)))))(n)
+(d (count-down 1000))(n)
+(d (define hello (lambda () 3)))(n)
+(d (count-down 1000))(n)
+(d (define (use-abs x) (abs x)))(n)
+(d (use-abs -4))(n)
+(d (define (abs x) (* x 10)))(n)
+(d (use-abs -4))(n)
+(d (define (twice f x) (f (f x))))(n)
+(d (twice use-abs 2))(n)
+(d (define x 5))(n)
+(d (define (get-x) x))(n)
+(d (get-x))(n)
+(d (define x 6))(n)
+(d (define y 7))(n)
+(d (get-x))(n)
+(d (define (get-z) z))(n)
+(d (get-z))(n)
@@ -0,0 +1,9 @@
+(define d display)(define n newline)
+(define (build k acc) (if (= k 0) acc (build (- k 1) (cons k acc))))
+(define (work y) (length (build 2000 (list y))))
+(define (f x) ((memoize (lambda (y) (work y))) x))
+(define (g x) ((memoize (lambda (y) (work y))) (list x x)))
+(define (loop i acc) (if (= i 0) acc (loop (- i 1) (+ acc (f i) (length (cdr (list i))) (g i)))))
+(d (loop 300 0))(n)
+(define (h x) ((memoize (lambda (p) (build 5000 p))) (list x)))
+(d (length (h 7)))(n)
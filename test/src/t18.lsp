@@ -0,0 +1,9 @@
+(define d display)(define n newline)
+(d (define first-key (car (car (runtime-stats)))))(n)
+(d first-key)(n)
+(d (integer? (cdr (car (runtime-stats)))))(n)
+(d (define counters (make-hash-table)))(n)
+(d (hash-set! counters first-key 1))(n)
+(d (hash-ref counters (car (car (runtime-stats))) 0))(n)
+(d (hash-ref counters (car (car (cdr (runtime-stats)))) 0))(n)
+(d (list first-key))(n)
@@ -0,0 +1,12 @@
+(define d display)(define n newline)
+(d (define (count k) (if (= k 0) 0 (count (- k 1)))))(n)
+(d (count 1000000))(n)
+(d (define (my-even? k) (if (= k 0) #t (my-odd? (- k 1)))))(n)
+(d (define (my-odd? k) (if (= k 0) #f (my-even? (- k 1)))))(n)
+(d (my-even? 1000000))(n)
+(d (my-odd? 1000001))(n)
+(d (my-even? 999999))(n)
+(d (define (count-cond k) (cond ((= k 0) 0) (#t (count-cond (- k 1))))))(n)
+(d (count-cond 1000000))(n)
+(d (define (count-let k) (let ((j (- k 1))) (if (< j 0) 0 (count-let j)))))(n)
+(d (count-let 1000000))(n)
@@ -0,0 +1,13 @@
+; check: cache
+; Runs from a program image, which must be rejected once damaged.
+(define (make-counter start)
+  (let ((count start))
+    (lambda (step) (let* ((next (+ count step)) (twice (* next 2))) (list next twice)))))
+(define counter (make-counter 10))
+(display (counter 1))
+(newline)
+(define (sum-to n acc) (if (= n 0) acc (sum-to (- n 1) (+ acc n))))
+(display (sum-to 1000 0))
+(newline)
+(display (cond ((> 1 2) 0) (#t (let ((x 3) (y 4)) (+ (* x x) (* y y))))))
+(newline)
@@ -0,0 +1,33 @@
+; run: --heap-size=256K
+; ignore: \d+ bytes live
+; Allocates far more than the heap holds, which only works if the
+; collector frees what is no longer reachable, cycles included.
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+(define (churn k total)
+  (if (= k 0) total (churn (- k 1) (+ total (length (build 500 ()))))))
+(display (churn 2000 0))
+(newline)
+; A vector and a closure that refer to each other
+(define (cycle k)
+  (let ((v (make-vector 4 k)))
+    (vector-set! v 0 (lambda () v))
+    v))
+(define (cycles k last)
+  (if (= k 0) (vector-ref last 3) (cycles (- k 1) (cycle k))))
+(display (cycles 20000 (cycle 0)))
+(newline)
+; A closure that calls itself through the vector holding it
+(define (counter start)
+  (let ((self (make-vector 1 0)))
+    (vector-set! self 0 (lambda (k) (if (= k 0) start ((vector-ref self 0) (- k 1)))))
+    (vector-ref self 0)))
+(define (counters k total)
+  (if (= k 0) total (counters (- k 1) (+ total ((counter k) 3)))))
+(display (counters 20000 0))
+(newline)
+(define kept (build 100 ()))
+(display (length kept))
+(newline)
+; Too much at once
+(display (length (build 100000 ())))
+(newline)
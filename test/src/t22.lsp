@@ -0,0 +1,14 @@
+; Forms are run as they are read, so everything before the form that
+; cannot be parsed has run (and printed) by the time it is reported.
+(display 1)
+(newline)
+(define (twice x)
+  (* x 2))
+(display (twice 21))
+(newline)
+(display (list 1
+               2))
+(newline)
+(display 4))
+(display 5)
+(newline)
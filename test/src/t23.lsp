@@ -0,0 +1,12 @@
+; CRLF line endings, and no newline after the last token, which ends
+; the mapped file itself.
+(define (add a b)
+  (+ a b))
+(display (add 12 30))
+(newline)
+(display (list #t #f 7))
+(newline)
+(define last 1234567)
+(display last)
+(newline)
+last
\ No newline at end of file
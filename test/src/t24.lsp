@@ -0,0 +1,8 @@
+; check: profile-samples
+; Runs long enough to be sampled many times.
+(define (spin n) (if (= n 0) 0 (spin (- n 1))))
+(define (outer k) (+ 1 (spin k)))
+(display (outer 200000))
+(newline)
+(display ((lambda (x) (outer x)) 100000))
+(newline)
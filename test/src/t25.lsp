@@ -0,0 +1,17 @@
+; run:
+; run: --unbuffered
+; Whether buffered or not, the output comes out in the order it was
+; printed, and everything printed before an error comes before its message.
+(display 1)
+(flush-output)
+(display 2)
+(newline)
+(display (list 3 4))
+(flush-output)
+(flush-output)
+(newline)
+(display 5)
+(define (fail x) (car x))
+(display 6)
+(fail 7)
+(display 8)